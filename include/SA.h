@@ -4,11 +4,27 @@
 #include "log.h"
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <typeinfo>
+#include <cstring>
 #include <new>
 #include <stdlib.h>
 #include <limits>
+#include <type_traits>
 #include "hexdump.h"
 #include <cassert>
+#include <cstdint>
+#include <memory_resource>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <cstdio>
+
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+#include <alloc_hook.h>
+#endif
 
 #ifndef RTTI_ENABLED
     #if defined(__clang__)
@@ -38,992 +54,4885 @@
     #endif
 #endif
 
+// largest request in bytes served from the thread local magazines, 0 disables them
+#ifndef SA_STACK_ALLOCATOR__MAGAZINE_MAX_SIZE
+#define SA_STACK_ALLOCATOR__MAGAZINE_MAX_SIZE 512
+#endif
+
+// full magazines worth of blocks a size class depot keeps, a drain pushing it past this returns the blocks above half
+// of it to the system, 0 never trims before exit
+#ifndef SA_STACK_ALLOCATOR__MAGAZINE_DEPOT_LIMIT
+#define SA_STACK_ALLOCATOR__MAGAZINE_DEPOT_LIMIT 16
+#endif
+
+// number of independently locked shards the pointer registries are split into, must be a power of two
+#ifndef SA_STACK_ALLOCATOR__SHARDS
+#define SA_STACK_ALLOCATOR__SHARDS 64
+#endif
+
+// 1 places the tracking record of TrackedAllocator::alloc allocations in a header right before the object, 0 keeps
+// every record in the pointer registry
+#ifndef SA_STACK_ALLOCATOR__HEADER_LAYOUT
+#define SA_STACK_ALLOCATOR__HEADER_LAYOUT 1
+#endif
+
+// events each thread can buffer before the drain thread catches up, must be a power of two
+#ifndef SA_STACK_ALLOCATOR__EVENT_RING_SIZE
+#define SA_STACK_ALLOCATOR__EVENT_RING_SIZE 4096
+#endif
+
+// mean number of bytes between two operator new override allocations the heap profiler samples, 0 disables it
+#ifndef SA_STACK_ALLOCATOR__HEAP_PROFILE_INTERVAL
+#define SA_STACK_ALLOCATOR__HEAP_PROFILE_INTERVAL 524288
+#endif
+
+// header lookups peek at memory right before pointers we may not own, hidden from the address and thread sanitizers
+#if defined(__clang__) || defined(__GNUC__)
+#define SA____STACK_ALLOCATOR__NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address, no_sanitize_thread))
+#else
+#define SA____STACK_ALLOCATOR__NO_SANITIZE_ADDRESS
+#endif
+
+// keeps a function's own frame on the stack so a backtrace taken in it knows how many frames to drop
+#if defined(__clang__) || defined(__GNUC__)
+#define SA____STACK_ALLOCATOR__NOINLINE __attribute__((noinline))
+#else
+#define SA____STACK_ALLOCATOR__NOINLINE
+#endif
+
+// keeps stores to p that are never read again from being optimized out, what explicit_bzero does after its memset
+#if defined(__clang__) || defined(__GNUC__)
+#define SA____STACK_ALLOCATOR__WIPE_BARRIER(p) __asm__ __volatile__("" : : "r"(p) : "memory")
+#else
+#define SA____STACK_ALLOCATOR__WIPE_BARRIER(p) std::atomic_signal_fence(std::memory_order_seq_cst)
+#endif
+
 #define SA____STACK_ALLOCATOR__REF_ONLY(C, CT) C() { if (log) { Logeb(); printf("%s()\n", #C); Logr(); } }; C(const CT & other) = delete; C(CT && other) = delete; CT & operator=(const CT & other) = delete; CT & operator=(CT && other) = delete
-#define SA____STACK_ALLOCATOR__REF_ONLY_T(C, T) C() { if (log) { SA::SINGLETONS::PER_TYPE<T> t; Logeb(); printf("%s<%s>()\n", #C, t.demangled); Logr(); } }; C(const C<T> & other) = delete; C(C<T> && other) = delete; C<T> & operator=(const C<T> & other) = delete; C<T> & operator=(C<T> && other) = delete
+#define SA____STACK_ALLOCATOR__REF_ONLY_T(C, T) C() { if (log) { SA::SINGLETONS::PER_TYPE<T> t; Logeb(); printf("%s<%s>()\n", #C, t.name()); Logr(); } }; C(const C<T> & other) = delete; C(C<T> && other) = delete; C<T> & operator=(const C<T> & other) = delete; C<T> & operator=(C<T> && other) = delete
 #define SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(C, CT) C(const CT & other) = delete; C(CT && other) = delete; CT & operator=(const CT & other) = delete; CT & operator=(CT && other) = delete
 
 namespace SA {
 
     struct AllocatorBase {};
 
-    template <typename T> struct Mallocator;
+    // WipePolicy, how memory is cleared when it is freed
+    //
+    // wipes tells whether blocks going back to the system are wiped, zero clears a block that is kept for reuse, the
+    // magazines hand out zeroed blocks so they are zeroed under every policy
+    //
+    // NoWipe leaves freed blocks as they are and zeroes with a plain memset
+    struct NoWipe {
+        static constexpr bool wipes = false;
+        static void zero(void * p, size_t size) {
+            memset(p, 0, size);
+        }
+    };
+
+    // FastWipe zeroes with memset behind a compiler barrier, the stores are vectorized by the C library and can not be
+    // dropped
+    struct FastWipe {
+        static constexpr bool wipes = true;
+        static void zero(void * p, size_t size) {
+            memset(p, 0, size);
+            SA____STACK_ALLOCATOR__WIPE_BARRIER(p);
+        }
+    };
+
+    // ParanoidWipe first overwrites the block with ones, then zeroes it a word at a time through volatile stores and
+    // fences so every store is issued even without a compiler barrier
+    struct ParanoidWipe {
+        static constexpr bool wipes = true;
+        static void zero(void * ptr, size_t size) {
+            memset(ptr, 0xFF, size);
+            SA____STACK_ALLOCATOR__WIPE_BARRIER(ptr);
+            uint8_t * p = static_cast<uint8_t*>(ptr);
+            while (size != 0 && (reinterpret_cast<uintptr_t>(p) & (sizeof(size_t) - 1)) != 0) {
+                *reinterpret_cast<volatile uint8_t*>(p) = 0;
+                p++;
+                size--;
+            }
+            volatile size_t * w = reinterpret_cast<volatile size_t*>(p);
+            for (size_t i = 0, n = size / sizeof(size_t); i < n; i++) {
+                w[i] = 0;
+            }
+            volatile uint8_t * s = p + size - size % sizeof(size_t);
+            for (size_t i = 0, n = size % sizeof(size_t); i < n; i++) {
+                s[i] = 0;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    };
+
+    template <typename T, typename WipePolicy = FastWipe> struct Mallocator;
 
     struct TrackedAllocator;
 
+#ifdef SA_STACK_ALLOCATOR__LOGGING
     extern bool log;
+#else
+    // logging is compiled out, link StackAllocatorL to get it
+    constexpr bool log = false;
+#endif
 
     struct SINGLETONS;
     extern SINGLETONS & GET_SINGLETONS();
 
+    struct RECLAIMER;
+    extern RECLAIMER & GET_RECLAIMER();
+
     extern TrackedAllocator * GET_GLOBAL();
     extern bool IS_GLOBAL(AllocatorBase * allocator);
 
-    struct SINGLETONS {
-        class recursive_mutex {
-            size_t lock_count_ = 0;
-            std::recursive_mutex mutex;
+    // bytes in use, the highest value current reached and every byte ever accounted
+    struct MemoryUsage {
+        size_t current;
+        size_t peak;
+        size_t total;
+    };
 
-            public:
+    struct MemorySnapshot;
+
+    template <typename LockPolicy> struct STD_NODE_CACHE;
+
+    // what a BasicAllocator is known by to the registry, the owner directory and the headers of its allocations, it is
+    // pooled and never moves, so moving an allocator hands its handle over instead of touching what it owns
+    //
+    // splicing an allocator into another forwards its handle to the other's, the headers naming it then belong to the
+    // other allocator without being visited, a spliced handle hangs off the handle it forwards to until the last header
+    // naming it is gone, see BasicAllocator::retire_locked
+    struct OWNER_HANDLE {
+        // the allocator currently known by this handle, nullptr once it is destroyed or spliced
+        void * allocator = nullptr;
+        // the handle this one was spliced into
+        OWNER_HANDLE * forward = nullptr;
+        // the handles spliced into this one, linked through sibling and prev_sibling
+        OWNER_HANDLE * absorbed = nullptr;
+        OWNER_HANDLE * sibling = nullptr;
+        OWNER_HANDLE * prev_sibling = nullptr;
+        // the listed headers naming this handle, guarded by the lock of the allocator listing them
+        size_t listed = 0;
+        // the handle of GET_GLOBAL(), see PTR_OWNERS
+        bool global = false;
+        // set once BasicAllocator::alloc_unlisted handed out a block, such blocks outlive the allocator and keep naming
+        // the handle, so it is never freed
+        std::atomic<bool> pinned {false};
+        // set while the handle is linked into SINGLETONS::live_allocators through prev_live and next_live
+        std::atomic<bool> live {false};
+        OWNER_HANDLE * prev_live = nullptr;
+        OWNER_HANDLE * next_live = nullptr;
+        // adds up the allocations the allocator lists that the registry does not know, for the report
+        void (*count_listed)(OWNER_HANDLE * h, size_t & objects, size_t & bytes) = nullptr;
+
+        // the handle that owns whatever names this one
+        OWNER_HANDLE * resolve() {
+            OWNER_HANDLE * h = this;
+            while (h->forward != nullptr) {
+                h = h->forward;
+            }
+            return h;
+        }
+
+        // frees h, its siblings and every handle spliced into them, a pinned one is only cut loose so its blocks find
+        // no allocator
+        static void release(OWNER_HANDLE * h);
+    };
+
+    // binary allocation event log, every record has the same size so the decoder (EXECUTABLES/sa_events) can walk the
+    // file without parsing
+    //
+    // the file starts with EVENT_FILE_HEADER, type names follow their TYPE_NAME record as raw bytes padded to whole
+    // records
+    struct EVENT {
+        enum OP : uint16_t {
+            CALLOC,
+            FREE,
+            // size bytes of type accounted to the statistics
+            ACCOUNT_ALLOC,
+            ACCOUNT_FREE,
+            // owner took a reference to pointer in the registry
+            REF,
+            UNREF,
+            RELEASE,
+            ALLOC,
+            DEALLOC,
+            ADOPT,
+            NEW,
+            NEW_ARRAY,
+            DELETE,
+            DELETE_ARRAY,
+            // type holds the alignment
+            ALIGNED_NEW,
+            ALIGNED_NEW_ARRAY,
+            ALIGNED_DELETE,
+            ALIGNED_DELETE_ARRAY,
+            // size events of the thread were lost to a full ring
+            DROPPED,
+            // size bytes of name for type follow
+            TYPE_NAME,
+            OP_COUNT
+        };
+
+        static constexpr uint64_t no_type = UINT64_MAX;
+
+        // nanoseconds of std::chrono::steady_clock
+        uint64_t timestamp;
+        uint16_t op;
+        uint16_t reserved;
+        uint32_t thread;
+        uint64_t pointer;
+        uint64_t size;
+        uint64_t type;
+        uint64_t owner;
+
+        static const char * op_name(uint16_t op) {
+            static const char * names[OP_COUNT] = {
+                "calloc", "free", "account alloc", "account free", "ref", "unref", "release", "alloc", "dealloc",
+                "adopt", "new", "new[]", "delete", "delete[]", "aligned new", "aligned new[]", "aligned delete",
+                "aligned delete[]", "dropped", "type name"
+            };
+            return op < OP_COUNT ? names[op] : "unknown";
+        }
+    };
+
+    static_assert(sizeof(EVENT) == 48, "event records are written as is");
+
+    struct EVENT_FILE_HEADER {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+
+        static constexpr const char * expected_magic = "SAEVENTS";
+    };
+
+#ifdef SA_STACK_ALLOCATOR__LOGGING
+    struct EVENT_LOG;
+    extern EVENT_LOG & GET_EVENT_LOG();
+
+    // each thread appends to its own single producer ring without any lock, a background thread drains every ring to
+    // the file named by the SA_STACK_ALLOCATOR_EVENT_LOG environment variable (default sa_events.bin)
+    //
+    // a full ring drops the event and counts it, producers never wait
+    struct EVENT_LOG {
+        struct RING {
+            std::atomic<size_t> head;
+            std::atomic<size_t> tail;
+            std::atomic<size_t> dropped;
+            // cleared when the thread exits, the next new thread picks the ring up again
+            std::atomic<bool> in_use;
+            RING * next;
+            EVENT events[SA_STACK_ALLOCATOR__EVENT_RING_SIZE];
+        };
+
+        static_assert((SA_STACK_ALLOCATOR__EVENT_RING_SIZE & (SA_STACK_ALLOCATOR__EVENT_RING_SIZE - 1)) == 0, "SA_STACK_ALLOCATOR__EVENT_RING_SIZE must be a power of two");
+
+        enum STATE { IDLE, STARTING, RUNNING, STOPPED };
+
+        std::atomic<int> state {IDLE};
+        // rings are never freed, only reused
+        std::atomic<RING*> rings {nullptr};
+        std::atomic<uint32_t> next_thread {0};
+        std::thread drainer;
+        FILE * file = nullptr;
+        // TYPE_NAME records already written, indexed by type
+        bool * named = nullptr;
+        size_t named_capacity = 0;
 
-            class Scoped {
-                recursive_mutex * scope;
-                
-                public:
+        SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(EVENT_LOG, EVENT_LOG);
 
-                Scoped(recursive_mutex * s) : scope(s) {
-                    scope->lock();
+        EVENT_LOG() = default;
+
+        struct ThreadState {
+            RING * ring;
+            uint32_t thread;
+            // the drain thread records nothing
+            bool silent;
+        };
+
+        // gives the ring back when the thread exits
+        struct Retire {
+            ~Retire() {
+                ThreadState & s = thread_state();
+                if (s.ring != nullptr) {
+                    s.ring->in_use.store(false, std::memory_order_release);
+                    s.ring = nullptr;
                 }
-                
-                Scoped(const Scoped & other) = delete;
-                Scoped & operator=(const Scoped & other) = delete;
+                s.silent = true;
+            }
+        };
 
-                Scoped(Scoped && other) = default;
-                Scoped & operator=(Scoped && other) = default;
+        static ThreadState & thread_state() {
+            thread_local ThreadState s;
+            return s;
+        }
 
-                ~Scoped() {
-                    scope->unlock();
+        RING * acquire_ring() {
+            for (RING * r = rings.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+                bool expected = false;
+                if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    return r;
                 }
-            };
+            }
+            // plain calloc, inspect_calloc would record an event
+            RING * r = static_cast<RING*>(calloc(1, sizeof(RING)));
+            if (r == nullptr) {
+                return nullptr;
+            }
+            r->in_use.store(true, std::memory_order_relaxed);
+            RING * head = rings.load(std::memory_order_relaxed);
+            do {
+                r->next = head;
+            } while (!rings.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+            return r;
+        }
+
+        void push(uint16_t op, const void * pointer, uint64_t size, uint64_t type, const void * owner) {
+            ThreadState & s = thread_state();
+            if (s.silent) {
+                return;
+            }
+            int st = state.load(std::memory_order_acquire);
+            if (st == STOPPED) {
+                return;
+            }
+            if (s.ring == nullptr) {
+                s.ring = acquire_ring();
+                if (s.ring == nullptr) {
+                    return;
+                }
+                s.thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+                // touching it registers its destructor for this thread
+                thread_local Retire retire;
+                (void) retire;
+            }
+            if (st == IDLE) {
+                start();
+            }
+            RING & r = *s.ring;
+            size_t head = r.head.load(std::memory_order_relaxed);
+            if (head - r.tail.load(std::memory_order_acquire) == SA_STACK_ALLOCATOR__EVENT_RING_SIZE) {
+                r.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            EVENT & e = r.events[head & (SA_STACK_ALLOCATOR__EVENT_RING_SIZE - 1)];
+            e.timestamp = now();
+            e.op = op;
+            e.reserved = 0;
+            e.thread = s.thread;
+            e.pointer = reinterpret_cast<uintptr_t>(pointer);
+            e.size = size;
+            e.type = type;
+            e.owner = reinterpret_cast<uintptr_t>(owner);
+            r.head.store(head + 1, std::memory_order_release);
+        }
 
-            Scoped scoped() { return {this}; }
+        static uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
 
-            size_t lock_count() { return lock_count_; }
+        static void record(uint16_t op, const void * pointer, uint64_t size = 0, uint64_t type = EVENT::no_type, const void * owner = nullptr) {
+            GET_EVENT_LOG().push(op, pointer, size, type, owner);
+        }
 
-            void lock() { mutex.lock(); lock_count_++; }
-            void unlock() { lock_count_--; mutex.unlock(); }
-            bool try_lock () {
-                if (mutex.try_lock()) {
-                    lock_count_++;
-                    return true;
+        void start() {
+            int expected = IDLE;
+            if (!state.compare_exchange_strong(expected, STARTING, std::memory_order_acq_rel)) {
+                return;
+            }
+            // the thread may allocate through an overridden operator new, which records into the ring we already hold
+            drainer = std::thread([this]() {
+                thread_state().silent = true;
+                while (state.load(std::memory_order_acquire) == RUNNING) {
+                    drain();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
                 }
+            });
+            expected = STARTING;
+            state.compare_exchange_strong(expected, RUNNING, std::memory_order_acq_rel);
+        }
+
+        // joins the drain thread and writes what is left, events recorded afterwards are ignored
+        void stop() {
+            int previous = state.exchange(STOPPED, std::memory_order_acq_rel);
+            if (previous == STOPPED) {
+                return;
+            }
+            if (drainer.joinable()) {
+                drainer.join();
+            }
+            drain();
+            if (file != nullptr) {
+                fclose(file);
+                file = nullptr;
+            }
+            free(named);
+            named = nullptr;
+            named_capacity = 0;
+        }
+
+        bool open() {
+            if (file != nullptr) {
+                return true;
+            }
+            const char * path = getenv("SA_STACK_ALLOCATOR_EVENT_LOG");
+            file = fopen(path != nullptr ? path : "sa_events.bin", "wb");
+            if (file == nullptr) {
                 return false;
             }
-        };
+            EVENT_FILE_HEADER header = {};
+            memcpy(header.magic, EVENT_FILE_HEADER::expected_magic, sizeof(header.magic));
+            header.version = 1;
+            header.record_size = sizeof(EVENT);
+            fwrite(&header, sizeof(header), 1, file);
+            return true;
+        }
+
+        void write_type_names();
 
-        recursive_mutex mutex;
+        void drain() {
+            if (!open()) {
+                return;
+            }
+            for (RING * r = rings.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+                size_t tail = r->tail.load(std::memory_order_relaxed);
+                size_t head = r->head.load(std::memory_order_acquire);
+                while (tail != head) {
+                    size_t index = tail & (SA_STACK_ALLOCATOR__EVENT_RING_SIZE - 1);
+                    size_t count = std::min(head - tail, SA_STACK_ALLOCATOR__EVENT_RING_SIZE - index);
+                    fwrite(&r->events[index], sizeof(EVENT), count, file);
+                    tail += count;
+                }
+                r->tail.store(tail, std::memory_order_release);
+                size_t dropped = r->dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped != 0) {
+                    EVENT e = {};
+                    e.timestamp = now();
+                    e.op = EVENT::DROPPED;
+                    e.size = dropped;
+                    e.type = EVENT::no_type;
+                    fwrite(&e, sizeof(e), 1, file);
+                }
+            }
+            write_type_names();
+            fflush(file);
+        }
+    };
 
-        size_t memory_usage = 0;
-        Mallocator<uint8_t> mallocator;
+#define SA____STACK_ALLOCATOR__EVENT(...) do { if (SA::log) { SA::EVENT_LOG::record(__VA_ARGS__); } } while (0)
+#else
+#define SA____STACK_ALLOCATOR__EVENT(...) do {} while (0)
+#endif
 
-        static void * inspect_calloc_return_value(void * return_value) {
-            if (log) {
-                Logib();
-                printf("CALLOC(%p)\n", return_value);
-                Logr();
+    struct SINGLETONS {
+        // guards creation of the per type statistics and keeps their log output together
+        std::recursive_mutex stats_mutex;
+
+        // current, peak and total of one accounting scope, updated with relaxed atomics so accounting never takes a
+        // lock, the peak is only written when a new high is reached
+        struct USAGE_COUNTER {
+            std::atomic<size_t> current {0};
+            std::atomic<size_t> peak {0};
+            std::atomic<size_t> total {0};
+
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(USAGE_COUNTER, USAGE_COUNTER);
+
+            USAGE_COUNTER() = default;
+
+            void add(size_t bytes) {
+                size_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+                total.fetch_add(bytes, std::memory_order_relaxed);
+                size_t high = peak.load(std::memory_order_relaxed);
+                while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {}
+            }
+
+            void sub(size_t bytes) {
+                current.fetch_sub(bytes, std::memory_order_relaxed);
+            }
+
+            // a batch of allocations and frees at once, delta is the net change of current, allocated what the batch
+            // added to total, the peak only sees where the batch ended
+            void apply(ptrdiff_t delta, size_t allocated) {
+                size_t now = current.fetch_add(static_cast<size_t>(delta), std::memory_order_relaxed) + static_cast<size_t>(delta);
+                total.fetch_add(allocated, std::memory_order_relaxed);
+                size_t high = peak.load(std::memory_order_relaxed);
+                while (static_cast<ptrdiff_t>(now) > 0 && now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {}
+            }
+
+            // adds the values of other to ours and clears other, for allocators taking over each other's allocations
+            void merge(USAGE_COUNTER & other) {
+                size_t moved = other.current.exchange(0, std::memory_order_relaxed);
+                size_t now = current.fetch_add(moved, std::memory_order_relaxed) + moved;
+                total.fetch_add(other.total.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+                size_t wanted = std::max(other.peak.exchange(0, std::memory_order_relaxed), now);
+                size_t high = peak.load(std::memory_order_relaxed);
+                while (wanted > high && !peak.compare_exchange_weak(high, wanted, std::memory_order_relaxed)) {}
+            }
+
+            // every value is read once, concurrent updates may land between the reads
+            MemoryUsage load() const {
+                MemoryUsage u;
+                // see SINGLETONS::settled
+                u.current = current.load(std::memory_order_relaxed);
+                if (static_cast<ptrdiff_t>(u.current) < 0) {
+                    u.current = 0;
+                }
+                u.total = total.load(std::memory_order_relaxed);
+                u.peak = std::max(peak.load(std::memory_order_relaxed), u.current);
+                return u;
             }
+        };
+
+        // every thread updates it, so it gets a line of its own
+        alignas(64) USAGE_COUNTER memory_usage;
+
+        // bookkeeping bytes held by the tracked pointer records (records, owner lists and bound deleter state) and the
+        // number of records, metadata_usage / tracked_objects is the overhead per tracked object
+        std::atomic<size_t> metadata_usage {0};
+        std::atomic<size_t> tracked_objects {0};
+
+        // bytes of the chunks the node pools carve their nodes from, metadata_usage is the part of it in use
+        std::atomic<size_t> metadata_reserved {0};
+
+        // the live blocks BasicAllocator::alloc_unlisted handed out (the operator new override's) and their bytes, they
+        // are in no header list and not in the registry, so the report lists them under global_owner, see UNLISTED_BATCH
+        std::atomic<size_t> unlisted_objects {0};
+        std::atomic<size_t> unlisted_bytes {0};
+
+        // the handle of GET_GLOBAL(), set when the override creates it
+        OWNER_HANDLE * global_owner = nullptr;
+
+        static void * inspect_calloc_return_value(void * return_value, size_t bytes) {
+            SA____STACK_ALLOCATOR__EVENT(EVENT::CALLOC, return_value, bytes);
             return return_value;
         }
 
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+        using heap_t = alloc_hook_heap_t;
+#else
+        using heap_t = void;
+#endif
+
         static void * inspect_calloc(size_t memb, size_t size) {
-            return inspect_calloc_return_value(calloc(memb, size));
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            return inspect_calloc_return_value(alloc_hook_calloc(memb, size), memb*size);
+#else
+            return inspect_calloc_return_value(calloc(memb, size), memb*size);
+#endif
         }
 
-        static void inspect_free(void * ptr) {
-            if (log) {
-                Logib();
-                printf("FREE(%p)\n", ptr);
-                Logr();
+        // allocates from the given alloc_hook heap, nullptr means the calling thread's default heap
+        //
+        // the heap is ignored when alloc_hook is not enabled
+        static void * inspect_heap_calloc(heap_t * heap, size_t memb, size_t size) {
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            if (heap != nullptr) {
+                // alloc_hook skips the memset when the page is known to be zero already
+                return inspect_calloc_return_value(alloc_hook_heap_calloc(heap, memb, size), memb*size);
             }
-            free(ptr);
+#endif
+            return inspect_calloc(memb, size);
         }
 
-        template <typename T>
-        struct PER_TYPE {
-            char * demangled = nullptr;
-            bool is_demangled = false;
-            size_t memory_usage = 0;
+        // zeroed memory aligned to alignment, a power of two at least sizeof(void*), released with inspect_free
+        static void * inspect_aligned_calloc(size_t alignment, size_t size) {
+            void * p = nullptr;
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            p = alloc_hook_zalloc_aligned(size, alignment);
+#else
+            if (posix_memalign(&p, alignment, size == 0 ? 1 : size) != 0) {
+                p = nullptr;
+            } else {
+                memset(p, 0, size);
+            }
+#endif
+            return inspect_calloc_return_value(p, size);
+        }
 
-            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(PER_TYPE, PER_TYPE<T>);
+        static void inspect_free(void * ptr) {
+            SA____STACK_ALLOCATOR__EVENT(EVENT::FREE, ptr);
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            alloc_hook_free(ptr);
+#else
+            free(ptr);
+#endif
+        }
 
-            PER_TYPE() {
+        // returns a malloc'd copy of the demangled name, or nullptr without RTTI
+        static char * demangle(const std::type_info * info) {
 #ifdef RTTI_ENABLED
-            if (!is_demangled) {
-                    auto & ti = typeid(T);
-#if defined(__clang__)
-                    int status = -1;
-                    auto tmp = abi::__cxa_demangle(ti.name(), NULL, NULL, &status);
-                    demangled = strdup(tmp);
-                    inspect_free(tmp);
-#elif defined(__GNUC__)
-                    int status = -1;
-                    auto tmp = abi::__cxa_demangle(ti.name(), NULL, NULL, &status);
-                    demangled = strdup(tmp);
-                    inspect_free(tmp);
+#if defined(__clang__) || defined(__GNUC__)
+            int status = -1;
+            auto tmp = abi::__cxa_demangle(info->name(), NULL, NULL, &status);
+            if (tmp == nullptr) {
+                return strdup(info->name());
+            }
+            char * demangled = strdup(tmp);
+            // the demangler allocates with the system malloc, not inspect_calloc
+            free(tmp);
+            return demangled;
 #elif defined(_MSC_VER)
-                    demangled = dup(it.name());
+            return _strdup(info->name());
 #else
-                    #error Unsupported compiler
+            #error Unsupported compiler
 #endif
-                    is_demangled = true;
-                }
 #else
-                demangled = "unknown type (RTTI NOT AVAILABLE)";
+            return nullptr;
+#endif
+        }
+
+        template <typename T>
+        static const std::type_info * type_info_of() {
+#ifdef RTTI_ENABLED
+            return &typeid(T);
+#else
+            return nullptr;
 #endif
+        }
+
+        // the statistics of one type, the name is demangled the first time it is printed so accounting never pays for
+        // it
+        struct TYPE_STATS {
+            USAGE_COUNTER memory_usage;
+
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(TYPE_STATS, TYPE_STATS);
+
+            TYPE_STATS(const std::type_info * info) : info(info) {}
+
+            const char * name() {
+                char * n = demangled.load(std::memory_order_acquire);
+                if (n == nullptr) {
+                    n = demangle(info);
+                    if (n == nullptr) {
+                        return "unknown type (RTTI NOT AVAILABLE)";
+                    }
+                    char * expected = nullptr;
+                    if (!demangled.compare_exchange_strong(expected, n, std::memory_order_acq_rel)) {
+                        free(n);
+                        n = expected;
+                    }
+                }
+                return n;
+            }
+
+            ~TYPE_STATS() {
+                free(demangled.load(std::memory_order_relaxed));
+            }
+
+            private:
+
+            const std::type_info * info;
+            std::atomic<char*> demangled {nullptr};
+        };
+
+        template <typename T>
+        struct PER_TYPE : TYPE_STATS {
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(PER_TYPE, PER_TYPE<T>);
+
+            PER_TYPE() : TYPE_STATS(type_info_of<T>()) {
                 if (log) {
                     Logeb();
-                    printf("PER_TYPE<%s>()\n", demangled);
+                    printf("PER_TYPE<%s>()\n", name());
                     Logr();
                 }
             }
-            
+
             ~PER_TYPE() {
                 if (log) {
                     Logeb();
-                    printf("~PER_TYPE<%s>()\n", demangled);
+                    printf("~PER_TYPE<%s>()\n", name());
                     Logr();
                 }
-                inspect_free(demangled);
             }
         };
 
-        template <typename T, typename ... Args>
-        [[nodiscard]] static T* alloc(Args && ... args) {
-            T * ptr;
-            ptr = static_cast<T*>(inspect_calloc(1, sizeof(T)));
-            new (ptr) T(std::forward<Args>(args)...);
-            return ptr;
-        }
-
-        template <typename T>
-        static void dealloc(T ** ptr) {
-            if (*ptr != nullptr) {
-                (*ptr)->~T();
-                inspect_free(*ptr);
-                *ptr = nullptr;
-            }
-        }
+        // a slab of fixed size nodes for the library's own bookkeeping, nodes are carved from chunk_bytes chunks aligned
+        // to their size so a node finds its chunk, and through it its pool, by masking its address
+        //
+        // chunks with free nodes are kept on the partial list, a chunk that empties is released unless it is the only
+        // one left so a single record coming and going does not map and unmap a chunk each time
+        //
+        // freed nodes are pushed on their chunk's free list, never-used nodes are carved lazily so a fresh chunk costs
+        // a single inspect_aligned_calloc
+        struct NODE_POOL {
+            static constexpr size_t chunk_bytes = 16 * 1024;
+
+            struct Chunk {
+                NODE_POOL * pool;
+                Chunk * prev;
+                Chunk * next;
+                void * free;
+                size_t live;
+                size_t carved;
+            };
 
-        template <typename T>
-        struct SA__LinkedList {
+            static constexpr size_t header_bytes = (sizeof(Chunk) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
 
-            SA____STACK_ALLOCATOR__REF_ONLY_T(SA__LinkedList, T);
+            // one per internal type or size class, their chunks are traced by the CALLOC and FREE events
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(NODE_POOL, NODE_POOL);
 
-            T * node = nullptr;
-            SA__LinkedList * next = nullptr;
-            SA__LinkedList * tail = nullptr;
-            size_t size = 0;
+            NODE_POOL(size_t node_size = 0) {
+                set_node_size(node_size);
+            }
 
-            void verify_tail() {
-                if (size == 0) {
-                    assert(tail == nullptr);
-                } else if (size == 1) {
-                    assert(tail == this);
-                } else {
-                    assert(tail != nullptr);
-                    assert(tail != this);
-                    assert(tail->next == nullptr);
-                }
+            void set_node_size(size_t bytes) {
+                node_size = (bytes + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+                capacity = node_size == 0 ? 0 : (chunk_bytes - header_bytes) / node_size;
             }
 
-            std::function<T*()> onNodeAlloc = []() {
-                return alloc<T>();
-            };
+            static Chunk * chunk_of(void * node) {
+                return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(node) & ~(chunk_bytes - 1));
+            }
 
-            T* append_node() {
-                verify_tail();
-                if (tail == nullptr) {
-                    tail = this;
+            void * alloc() {
+                std::lock_guard<std::mutex> guard(mutex);
+                Chunk * c = partial;
+                if (c == nullptr) {
+                    c = static_cast<Chunk*>(inspect_aligned_calloc(chunk_bytes, chunk_bytes));
+                    if (c == nullptr) throw std::bad_alloc();
+                    c->pool = this;
+                    link(c);
+                    GET_SINGLETONS().metadata_reserved.fetch_add(chunk_bytes, std::memory_order_relaxed);
+                }
+                void * node = c->free;
+                if (node != nullptr) {
+                    c->free = *static_cast<void**>(node);
+                    // carved nodes are zero already, reused ones are cleared to keep the calloc semantics
+                    memset(node, 0, node_size);
+                } else {
+                    node = reinterpret_cast<uint8_t*>(c) + header_bytes + c->carved * node_size;
+                    c->carved++;
                 }
-                if(tail->node != nullptr) {
-                    tail->next = alloc<SA__LinkedList<T>>();
-                    tail = tail->next;
+                if (++c->live == capacity) {
+                    unlink(c);
                 }
-                tail->node = onNodeAlloc();
-                size++;
-                verify_tail();
-                return tail->node;
+                return node;
             }
 
-            T * find_or_add(std::function<bool(T*node)> pred) {
-                if (size == 0) {
-                    return append_node();
-                } else {
-                    verify_tail();
-                    if (size == 1) {
-                        if (pred(node)) {
-                            return node;
-                        } else {
-                            assert(next == nullptr);
-                            tail->next = alloc<SA__LinkedList<T>>();
-                            tail = tail->next;
-                            tail->node = onNodeAlloc();
-                            size++;
-                            verify_tail();
-                            return tail->node;
-                        }
-                    }
-                    auto current = this;
-                    if (size > 1) {
-                        Logwb();
-                        printf("searching %zu nodes...\n", size);
-                        Logr();
+            // returns node to the pool it was carved from
+            static void dealloc(void * node) {
+                Chunk * c = chunk_of(node);
+                NODE_POOL * pool = c->pool;
+                bool release = false;
+                {
+                    std::lock_guard<std::mutex> guard(pool->mutex);
+                    if (c->live-- == pool->capacity) {
+                        pool->link(c);
                     }
-                    while(current->node != nullptr) {
-                        if (pred(current->node)) {
-                            verify_tail();
-                            return current->node;
-                        } else {
-                            if (current->next == nullptr) {
-                                assert(current == tail);
-                                tail->next = alloc<SA__LinkedList<T>>();
-                                tail = tail->next;
-                            }
-                            current = current->next;
-                        }
+                    if (c->live == 0 && (c->prev != nullptr || c->next != nullptr)) {
+                        pool->unlink(c);
+                        release = true;
+                    } else {
+                        *static_cast<void**>(node) = c->free;
+                        c->free = node;
                     }
-                    current->node = onNodeAlloc();
-                    size++;
-                    verify_tail();
-                    return current->node;
-                }
-            }
-
-            void remove_node_from_start() {
-                verify_tail();
-                dealloc(&node);
-                if (next != nullptr) {
-                    SA__LinkedList<T> * old = next;
-                    node = next->node;
-                    next = next->next;
-                    old->node = nullptr;
-                    old->next = nullptr;
-                    if (tail == old) tail = this;
-                    dealloc(&old);
-                } else {
-                    // we have removed this node, this->node == nullptr && this->next == nullptr, tail is now nullptr
-                    tail = nullptr;
                 }
-                size--;
-                verify_tail();
+                if (release) {
+                    GET_SINGLETONS().metadata_reserved.fetch_sub(chunk_bytes, std::memory_order_relaxed);
+                    inspect_free(c);
+                }
             }
 
-            struct FoundNode {
-                SA__LinkedList<T> * before_found;
-                SA__LinkedList<T> * found;
-            };
-
-            void remove_node(FoundNode f) {
-                if (f.found == nullptr) {
-                    Logeb();
-                    printf("f.found is nullptr, this is an error\n");
-                    Logr();
-                } else {
-                    if (f.found == this) {
-                        remove_node_from_start();
-                    } else {
-                        verify_tail();
-                        if (tail == f.found) tail = f.before_found;
-                        SA__LinkedList<T> * node_to_link = f.found->next;
-                        dealloc(&f.found->node);
-                        dealloc(&f.found);
-                        f.before_found->next = node_to_link;
-                        size--;
-                        verify_tail();
+            ~NODE_POOL() {
+                // chunks still holding nodes are left alone, whatever owns those nodes outlived us
+                Chunk * c = partial;
+                while (c != nullptr) {
+                    Chunk * next = c->next;
+                    if (c->live == 0) {
+                        GET_SINGLETONS().metadata_reserved.fetch_sub(chunk_bytes, std::memory_order_relaxed);
+                        inspect_free(c);
                     }
+                    c = next;
                 }
             }
 
+            private:
 
-            FoundNode find_node(std::function<bool(T*node)> pred) {
-                verify_tail();
-                if (size == 0) return {nullptr, nullptr};
-                if (size == 1) if (pred(node)) return {this, this};
-                auto current = this;
-                auto prev = current;
-                if (size > 1) {
-                    Logwb();
-                    printf("searching %zu nodes...\n", size);
-                    Logr();
-                }
-                while(current->node != nullptr) {
-                    if (pred(current->node)) {
-                        verify_tail();
-                        return {prev, current};
-                    } else {
-                        if (current->next == nullptr) {
-                            verify_tail();
-                            return {nullptr, nullptr};
-                        }
-                        prev = current;
-                        current = current->next;
-                    }
+            void link(Chunk * c) {
+                c->prev = nullptr;
+                c->next = partial;
+                if (partial != nullptr) {
+                    partial->prev = c;
                 }
-                verify_tail();
-                return {nullptr, nullptr};
+                partial = c;
             }
 
-            void warn_ptr(const char * tag, void * ptr) {
-                verify_tail();
-                if (ptr != nullptr) {
-                    Logeb();
-                    printf("%s: COULD NOT FIND TRACKED POINTER %p\n", tag, ptr);
-                    Logr();
-                    // abort();
+            void unlink(Chunk * c) {
+                if (c->prev != nullptr) {
+                    c->prev->next = c->next;
+                } else {
+                    partial = c->next;
                 }
-            }
-
-            void remove_all() {
-                verify_tail();
-                while (size != 0) {
-                    remove_node_from_start();
+                if (c->next != nullptr) {
+                    c->next->prev = c->prev;
                 }
+                c->prev = nullptr;
+                c->next = nullptr;
             }
 
-            virtual ~SA__LinkedList() {
-                if (log) {
-                    SA::SINGLETONS::PER_TYPE<T> t;
-                    Logeb();
-                    printf("~SA__LinkedList<%s>()\n", t.demangled);
-                    Logr();
-                }
-                remove_all();
-            }
+            std::mutex mutex;
+            size_t node_size = 0;
+            size_t capacity = 0;
+            Chunk * partial = nullptr;
         };
 
-        struct ID {
-            SA____STACK_ALLOCATOR__REF_ONLY(ID, ID);
-            const std::type_info * info = nullptr;
-            void * data = nullptr;
-            std::function<void(void*)> destructor;
-            ID(const std::type_info * info, void * data, std::function<void(void*)> destructor) : info(info), data(data), destructor(destructor) {
-                if (log) {
-                    Logeb();
-                    printf("ID()\n");
-                    Logr();
+        // the shared pools, one per 16 byte size class up to max_size, internal types too large or too aligned for
+        // them go straight to inspect_calloc
+        struct NODE_POOLS {
+            static constexpr size_t granularity = 16;
+            static constexpr size_t max_size = 256;
+            static constexpr size_t classes = max_size / granularity;
+
+            NODE_POOL pools[classes];
+
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(NODE_POOLS, NODE_POOLS);
+
+            NODE_POOLS() {
+                for (size_t i = 0; i < classes; i++) {
+                    pools[i].set_node_size((i + 1) * granularity);
                 }
-            }
-            ~ID() {
                 if (log) {
                     Logeb();
-                    printf("~ID()\n");
+                    printf("NODE_POOLS()\n");
                     Logr();
                 }
-                destructor(data);
             }
-        };
-
-        struct ID_LL : private SA__LinkedList<ID> {
-            using SA__LinkedList<ID>::size;
-            SA____STACK_ALLOCATOR__REF_ONLY(ID_LL, ID_LL);
 
             template <typename T>
-            PER_TYPE<T> & get_per_type() {
-                onNodeAlloc = []() {
-                    auto & type = typeid(T);
-                    return alloc<ID>(&type, alloc<PER_TYPE<T>>(), [](void*data) {
-                        PER_TYPE<T>* p = static_cast<PER_TYPE<T>*>(data);
-                        dealloc(&p);
-                    });
-                };
-                return *static_cast<PER_TYPE<T>*>(find_or_add([](ID*node){return *node->info == typeid(T);})->data);
+            static constexpr bool pooled() {
+                return sizeof(T) <= max_size && alignof(T) <= alignof(std::max_align_t);
             }
 
-            ~ID_LL() {
-                if (log) {
-                    Logeb();
-                    printf("~ID_LL()\n");
-                    Logr();
-                }
+            template <typename T>
+            NODE_POOL & for_type() {
+                return pools[(sizeof(T) + granularity - 1) / granularity - 1];
             }
-
-            protected:
         };
 
-        ID_LL per_type_linked_list;
+        NODE_POOLS node_pools;
+
+        template <typename T, typename ... Args>
+        [[nodiscard]] static T* alloc(Args && ... args) {
+            T * ptr;
+            if constexpr (NODE_POOLS::pooled<T>()) {
+                ptr = static_cast<T*>(GET_SINGLETONS().node_pools.for_type<T>().alloc());
+            } else {
+                ptr = static_cast<T*>(inspect_calloc(1, sizeof(T)));
+            }
+            new (ptr) T(std::forward<Args>(args)...);
+            return ptr;
+        }
+
+        // like alloc but carved from the given pool, the node is released by dealloc like any other
+        template <typename T, typename ... Args>
+        [[nodiscard]] static T* alloc_from(NODE_POOL & pool, Args && ... args) {
+            static_assert(NODE_POOLS::pooled<T>(), "type too large or too aligned for a node pool");
+            T * ptr = static_cast<T*>(pool.alloc());
+            new (ptr) T(std::forward<Args>(args)...);
+            return ptr;
+        }
 
         template <typename T>
-        PER_TYPE<T> & per_type() {
-            return per_type_linked_list.get_per_type<T>();
+        static void dealloc(T ** ptr) {
+            if (*ptr != nullptr) {
+                (*ptr)->~T();
+                if constexpr (NODE_POOLS::pooled<T>()) {
+                    NODE_POOL::dealloc(*ptr);
+                } else {
+                    inspect_free(*ptr);
+                }
+                *ptr = nullptr;
+            }
         }
 
-        struct PTR_LL : private SA__LinkedList<void*> {
-            using SA__LinkedList<void*>::size;
-            SA____STACK_ALLOCATOR__REF_ONLY(PTR_LL, PTR_LL);
+        // pointer keyed open addressing hash map, linear probing with backward shift deletion
+        //
+        // a nullptr key marks an empty slot, nullptr can never be inserted
+        //
+        // the table is allocated directly via inspect_calloc so it never recurses into an overridden operator new
+        template <typename V>
+        struct SA__PointerMap {
 
-            public:
+            // one per shard and per allocator, whatever owns the map does the logging
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(SA__PointerMap, SA__PointerMap);
 
-            void add_pointer(void * p) {
-                append_node()[0] = p;
+            SA__PointerMap() = default;
+
+            struct Entry {
+                void * key;
+                V value;
+            };
+
+            Entry * entries = nullptr;
+            size_t capacity = 0;
+            size_t size = 0;
+
+            static size_t hash(void * key) {
+                // murmur3 fmix64, heap addresses share their low bits so they must be mixed
+                uint64_t k = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+                k ^= k >> 33;
+                k *= 0xff51afd7ed558ccdULL;
+                k ^= k >> 33;
+                k *= 0xc4ceb9fe1a85ec53ULL;
+                k ^= k >> 33;
+                return static_cast<size_t>(k);
             }
 
-            void ** find_or_add_pointer(std::function<bool(void**node)> pred) {
-                bool f = false;
-                void ** ptr = find_or_add([&](void**ptr) {
-                    if (pred(ptr)) {
-                        f = true;
+            size_t index_of(void * key) const {
+                size_t mask = capacity - 1;
+                size_t i = hash(key) & mask;
+                while (entries[i].key != nullptr) {
+                    if (entries[i].key == key) {
+                        return i;
                     }
-                    return f;
-                });
-                return ptr;
+                    i = (i + 1) & mask;
+                }
+                return capacity;
             }
 
-            void ** find_pointer(void * p) {
-                return find_pointer(p, true);
+            V * find(void * key) {
+                if (size == 0) return nullptr;
+                size_t i = index_of(key);
+                return i == capacity ? nullptr : &entries[i].value;
             }
 
-            void ** find_pointer(void * p, bool warn_not_found) {
-                if (size == 0) {
-                    if (warn_not_found) {
-                        warn_ptr("FIND", p);
-                    }
-                    return nullptr;
+            void reserve(size_t count) {
+                // keep the load factor at or below 1/2
+                size_t wanted = 16;
+                while (wanted < count * 2) {
+                    wanted *= 2;
                 }
-                auto l = find_node([&](void**ptr) {
-                    return *ptr == p;
-                });
-                if (l.found != nullptr) {
-                    if (log) {
-                        Logeb();
-                        printf("FIND: found tracked pointer %p with wanted pointer %p\n", *l.found->node, p);
-                        Logr();
-                    }
-                    return l.found->node;
-                } else {
-                    if (warn_not_found) {
-                        warn_ptr("FIND", p);
+                if (wanted <= capacity) return;
+                Entry * old = entries;
+                size_t old_capacity = capacity;
+                entries = static_cast<Entry*>(inspect_calloc(wanted, sizeof(Entry)));
+                if (entries == nullptr) {
+                    entries = old;
+                    throw std::bad_alloc();
+                }
+                capacity = wanted;
+                size_t mask = capacity - 1;
+                for (size_t o = 0; o < old_capacity; o++) {
+                    if (old[o].key != nullptr) {
+                        size_t i = hash(old[o].key) & mask;
+                        while (entries[i].key != nullptr) {
+                            i = (i + 1) & mask;
+                        }
+                        entries[i] = old[o];
                     }
                 }
-                return nullptr;
+                if (old != nullptr) {
+                    inspect_free(old);
+                }
             }
 
-            bool remove_all_pointers_except(void * p) {
-                if (size == 0) {
-                    warn_ptr("REMOVE ALL EXCEPT", p);
-                    return false;
+            // returns the value for key, inserting a zero initialized value if the key is absent
+            V & find_or_add(void * key, bool & found) {
+                assert(key != nullptr);
+                if ((size + 1) * 2 > capacity) {
+                    reserve(size + 1);
                 }
-                bool f = false;
-                LOOP:
-                auto l = find_node([&](void**ptr) {
-                    return *ptr != p;
-                });
-                if (l.found != nullptr) {
-                    f = true;
-                    if (log) {
-                        Logeb();
-                        printf("REMOVE ALL EXCEPT: found tracked pointer %p\n", *l.found->node);
-                        Logr();
+                size_t mask = capacity - 1;
+                size_t i = hash(key) & mask;
+                while (entries[i].key != nullptr) {
+                    if (entries[i].key == key) {
+                        found = true;
+                        return entries[i].value;
                     }
-                    remove_node(l);
-                    goto LOOP;
+                    i = (i + 1) & mask;
                 }
-                return f;
+                found = false;
+                entries[i].key = key;
+                entries[i].value = V();
+                size++;
+                return entries[i].value;
             }
 
-            bool remove_pointer(void * p) {
-                if (size == 0) {
-                    warn_ptr("REMOVE", p);
-                    return false;
+            bool remove(void * key, V * out = nullptr) {
+                if (size == 0) return false;
+                size_t i = index_of(key);
+                if (i == capacity) return false;
+                if (out != nullptr) {
+                    *out = entries[i].value;
                 }
-                auto l = find_node([&](void**ptr) {
-                    return *ptr == p;
-                });
-                if (l.found != nullptr) {
-                    if (log) {
-                        Logeb();
-                        printf("REMOVE: found tracked pointer %p with wanted pointer %p\n", *l.found->node, p);
-                        Logr();
+                // backward shift deletion, pull every displaced entry of this cluster into the hole
+                size_t mask = capacity - 1;
+                size_t hole = i;
+                size_t j = i;
+                while (true) {
+                    j = (j + 1) & mask;
+                    if (entries[j].key == nullptr) break;
+                    size_t home = hash(entries[j].key) & mask;
+                    // entry j may move into the hole only if its home slot is not cyclically in (hole, j]
+                    if (((j - home) & mask) >= ((j - hole) & mask)) {
+                        entries[hole] = entries[j];
+                        hole = j;
                     }
-                    remove_node(l);
-                    return true;
                 }
-                warn_ptr("REMOVE", p);
-                return false;
+                entries[hole].key = nullptr;
+                entries[hole].value = V();
+                size--;
+                return true;
             }
-            
-            ~PTR_LL() {
-                auto s = 0;
-                if (s != 0) {
-                    if (s != 1) {
-                        Logeb();
-                        printf("~PTR_LL(), FREEING %zu TrackedMallocator/OwnerReference POINTERS\n", s);
-                        Logr();
-                    }
-                    remove_all();
-                    if (s != 1) {
-                        Logeb();
-                        printf("~PTR_LL(), ALL TrackedMallocator/OwnerReference POINTERS HAVE BEEN FREED\n");
-                        Logr();
+
+            template <typename F>
+            void for_each(F f) {
+                for (size_t i = 0; i < capacity; i++) {
+                    if (entries[i].key != nullptr) {
+                        f(entries[i].key, entries[i].value);
                     }
                 }
             }
-        };
 
-        // these are used by TrackedMallocator and by the TrackedAllocator for storing PointerInfo owner references
-        PTR_LL pointers;
-
-        struct PointerInfo {
-            SA____STACK_ALLOCATOR__REF_ONLY(PointerInfo, PointerInfo);
-            void * pointer = nullptr;
-            bool adopted = false;
-            std::size_t count = 0;
-            std::function<void(void*)> t_destructor;
-            std::function<void(PointerInfo&)> destructor;
-            PTR_LL refs;
+            void clear() {
+                if (entries != nullptr) {
+                    inspect_free(entries);
+                }
+                entries = nullptr;
+                capacity = 0;
+                size = 0;
+            }
 
-            void release() {
-                pointer = nullptr;
-                adopted = false;
-                count = 0;
+            void swap(SA__PointerMap & other) {
+                std::swap(entries, other.entries);
+                std::swap(capacity, other.capacity);
+                std::swap(size, other.size);
             }
 
-            virtual ~PointerInfo() {
-                if (log) {
-                    Logeb();
-                    printf("~PointerInfo()\n");
-                    Logr();
-                }
-                destructor(*this);
+            virtual ~SA__PointerMap() {
+                clear();
             }
         };
 
-        struct PTRINFO_LL : private SA__LinkedList<PointerInfo> {
-            using SA__LinkedList<PointerInfo>::size;
-            SA____STACK_ALLOCATOR__REF_ONLY(PTRINFO_LL, PTRINFO_LL);
+        // the statistics of every accounted type, a type is given its index the first time it is accounted and the
+        // slot is then cached by per_type_slot, so the table is only touched once per type
+        struct TYPE_TABLE {
+            struct Entry {
+                TYPE_STATS * stats;
+                void (*destroy)(TYPE_STATS * stats);
+            };
 
-            PointerInfo & ref(void * ptr, void * owner) {
-                bool f = false;
-                PointerInfo * p = find_or_add([&](PointerInfo*p) {
-                    if (p->pointer == ptr) {
-                        f = true;
-                    }
-                    return f;
-                });
-                if (f) {
-                    if (log) {
-                        Logeb();
-                        printf("REF: found tracked pointer %p with wanted pointer %p\n", p->pointer, ptr);
-                        Logr();
-                    }
-                } else {
-                    p->pointer = ptr;
-                    if (log) {
-                        Logeb();
-                        printf("REF: added tracked pointer %p with wanted pointer %p\n", p->pointer, ptr);
-                        Logr();
-                    }
-                }
-                bool pf = false;
-                void ** o = p->refs.find_or_add_pointer([&](void**p) {
-                    if (*p == owner) {
-                        pf = true;
+            Entry * entries = nullptr;
+            size_t capacity = 0;
+
+            SA____STACK_ALLOCATOR__REF_ONLY(TYPE_TABLE, TYPE_TABLE);
+
+            static size_t next_index() {
+                static std::atomic<size_t> next {0};
+                return next.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            template <typename T>
+            static size_t index_of() {
+                static const size_t index = next_index();
+                return index;
+            }
+
+            // callers hold stats_mutex
+            template <typename T>
+            PER_TYPE<T> & get() {
+                size_t index = index_of<T>();
+                if (index >= capacity) {
+                    size_t wanted = capacity == 0 ? 64 : capacity;
+                    while (wanted <= index) {
+                        wanted *= 2;
                     }
-                    return pf;
-                });
-                if (pf) {
-                    if (log) {
-                        Logeb();
-                        printf("REF: found tracked owner pointer %p with wanted pointer %p\n", *o, owner);
-                        Logr();
+                    Entry * grown = static_cast<Entry*>(inspect_calloc(wanted, sizeof(Entry)));
+                    if (grown == nullptr) {
+                        throw std::bad_alloc();
                     }
-                } else {
-                    *o = owner;
-                    if (log) {
-                        Logeb();
-                        printf("REF: added tracked owner pointer %p with wanted pointer %p\n", *o, owner);
-                        Logr();
+                    if (entries != nullptr) {
+                        memcpy(grown, entries, capacity * sizeof(Entry));
+                        inspect_free(entries);
                     }
+                    entries = grown;
+                    capacity = wanted;
                 }
-                return *p;
-            }
-            
-            bool release(void * ptr) {
-                if (size == 0) {
-                    warn_ptr("RELEASE", ptr);
-                    return false;
-                }
-                auto l = find_node([&](PointerInfo*p) {
-                    return p->pointer == ptr;
-                });
-                if (l.found != nullptr) {
-                    if (log) {
-                        Logeb();
-                        printf("RELEASE: found tracked pointer %p with wanted pointer %p\n", l.found->node->pointer, ptr);
-                        Logr();
-                    }
-                    // dont release if owned by global
-                    auto global = GET_GLOBAL();
-                    if (l.found->node->refs.find_pointer(global, false) != nullptr) {
-                        if (l.found->node->refs.size != 1) {
-                            l.found->node->refs.remove_all_pointers_except(global);
-                            return true;
-                        }
-                        return false;
-                    } else {
-                        // we are not owned by global, it is safe to release
-                        l.found->node->release();
-                        remove_node(l);
-                        return true;
-                    }
+                Entry & e = entries[index];
+                if (e.stats == nullptr) {
+                    e.stats = alloc<PER_TYPE<T>>();
+                    e.destroy = [](TYPE_STATS * stats) {
+                        PER_TYPE<T> * p = static_cast<PER_TYPE<T>*>(stats);
+                        dealloc(&p);
+                    };
                 }
-                warn_ptr("RELEASE", ptr);
-                return false;
+                return *static_cast<PER_TYPE<T>*>(e.stats);
             }
 
-            void unref(void * ptr, void * owner, std::function<bool(void*,void*)> pred) {
-                if (size == 0) {
-                    warn_ptr("UNREF", ptr);
-                    return;
-                }
-                auto l = find_node([&](PointerInfo*p) {
-                    return pred(p->pointer, ptr);
-                });
-                if (l.found != nullptr) {
-                    if (log) {
-                        Logeb();
-                        printf("UNREF: found tracked pointer %p with wanted pointer %p\n", l.found->node->pointer, ptr);
-                        Logr();
-                    }
-                    if (l.found->node->refs.find_pointer(owner, false) != nullptr) {
-                        if (l.found->node->refs.size == 1) {
-                            remove_node(l);
-                        } else {
-                            l.found->node->refs.remove_pointer(owner);
-                        }
+            template <typename F>
+            void for_each(F f) {
+                for (size_t i = 0; i < capacity; i++) {
+                    if (entries[i].stats != nullptr) {
+                        f(*entries[i].stats);
                     }
-                } else {
-                    warn_ptr("UNREF", ptr);
                 }
             }
 
-            ~PTRINFO_LL() {
-                auto s = 0;
-                if (s != 0) {
-                    if (s != 1) {
-                        Logeb();
-                        printf("~PTRINFO_LL(), FREEING %zu TrackedAllocator POINTERS\n", s);
-                        Logr();
-                    }
-                    remove_all();
-                    if (s != 1) {
-                        Logeb();
-                        printf("~PTRINFO_LL(), ALL TrackedAllocator POINTERS HAVE BEEN FREED\n");
-                        Logr();
+            ~TYPE_TABLE() {
+                for (size_t i = capacity; i != 0; i--) {
+                    Entry & e = entries[i - 1];
+                    if (e.stats != nullptr) {
+                        e.destroy(e.stats);
                     }
                 }
+                if (entries != nullptr) {
+                    inspect_free(entries);
+                }
             }
         };
 
-        // these are used by the TrackedAllocator
-        PTRINFO_LL tracked_pointers;
-
-        SA____STACK_ALLOCATOR__REF_ONLY(SINGLETONS, SINGLETONS);
+        TYPE_TABLE per_type_table;
 
-        ~SINGLETONS() {
-            if (log) {
-                Logeb();
-                printf("~SINGLETONS()\n");
-                Logr();
-            }
+        template <typename T>
+        PER_TYPE<T> & per_type() {
+            return per_type_slot<T>();
         }
-    };
 
-    class save_cout {
-        std::ostream & s;
-        std::ios_base::fmtflags f;
+        // the global, per type and per allocator usage, see MemorySnapshot
+        MemorySnapshot snapshot();
 
-        public:
+        // writes what is still allocated as JSON, by type, by owning allocator and by allocation site when the heap
+        // profiler runs, the registry is visited once and so is the header list of every allocator in live_allocators,
+        // the operator new override's blocks are counted under the global allocator, returns false if the file could
+        // not be written
+        //
+        // a pointer shared by several allocators is counted under each of them
+        bool write_report(const char * path);
 
-        save_cout() : save_cout(std::cout) {}
-        save_cout(std::ostream & o) : s(o), f(o.flags()) {}
-        template <typename T> std::ostream & operator<<(const T & item) { return s << item; }
-        std::ostream & operator*() { return s; }
-        std::ostream * operator->() { return &s; }
-        ~save_cout() { s.setf(f); }
-    };
+        // writes the live allocation sites as the members of a JSON array, set by the heap profiler
+        void (*report_sites)(FILE * file) = nullptr;
 
-    template<typename T>
-    struct Mallocator
-    {
-        typedef T value_type;
-    
-        Mallocator () = default;
+        // prints the total and per type memory usage, this is where type names get demangled
+        void print_memory_usage() {
+            flush_unlisted();
+            std::lock_guard<std::recursive_mutex> guard(stats_mutex);
+            Logib();
+            MemoryUsage total = memory_usage.load();
+            printf("total memory usage: %zu bytes, peak %zu bytes, %zu bytes allocated in total\n", total.current, total.peak, total.total);
+            printf("internal metadata: %zu bytes in use, %zu bytes reserved\n", settled(metadata_usage.load()), metadata_reserved.load());
+            per_type_table.for_each([](TYPE_STATS & stats) {
+                MemoryUsage u = stats.memory_usage.load();
+                printf("    '%s': %zu bytes, peak %zu bytes, %zu bytes allocated in total\n", stats.name(), u.current, u.peak, u.total);
+            });
+            Logr();
+        }
 
-        template<class U>
-        constexpr Mallocator (const Mallocator <U>&) noexcept {};
+        template <typename T>
+        void account_alloc(size_t bytes) {
+            memory_usage.add(bytes);
+            per_type_slot<T>().memory_usage.add(bytes);
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ACCOUNT_ALLOC, nullptr, bytes, TYPE_TABLE::index_of<T>());
+        }
 
-        template<class U>
-        constexpr Mallocator<T> & operator= (const Mallocator <U>&) noexcept {
-            return *this;
-        };
+        template <typename T>
+        void account_free(size_t bytes) {
+            memory_usage.sub(bytes);
+            per_type_slot<T>().memory_usage.sub(bytes);
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ACCOUNT_FREE, nullptr, bytes, TYPE_TABLE::index_of<T>());
+        }
 
-        template<class U>
-        constexpr bool operator== (const Mallocator <U>&) noexcept { return true; }
+        // the accounting of the operator new override's blocks, every new and delete would otherwise update the shared
+        // counters, so each thread adds up its own and applies them every batch operations, once its count moved by
+        // more than batch_bytes and when it exits, the counters lag behind by at most that much per thread, snapshot(),
+        // write_report and print_memory_usage apply the calling thread's first
+        struct UNLISTED_BATCH {
+            static constexpr size_t batch = 64;
+            static constexpr size_t batch_bytes = 65536;
+
+            // trivially destructible so it stays usable after the Flusher below has run at thread exit
+            struct ThreadState {
+                ptrdiff_t objects;
+                ptrdiff_t bytes;
+                ptrdiff_t metadata;
+                size_t allocated;
+                size_t operations;
+                bool dead;
+            };
 
-        template<class U>
-        constexpr bool operator!= (const Mallocator <U>&) noexcept { return false; }
+            struct Flusher {
+                ~Flusher() {
+                    ThreadState & s = state();
+                    GET_SINGLETONS().flush_unlisted();
+                    // anything accounted on this thread from now on is applied right away
+                    s.dead = true;
+                }
+            };
 
-        virtual ~Mallocator() {}
+            static ThreadState & state() {
+                thread_local ThreadState s;
+                return s;
+            }
 
-        virtual void onAlloc(T * p, size_t n) {}
-        virtual bool onDealloc(T * p, size_t n) { return true; }
+            // the state of a thread about to account, a batch that starts makes sure its thread flushes at exit
+            static ThreadState & starting() {
+                ThreadState & s = state();
+                if (s.operations == 0 && !s.dead) {
+                    // touching the flusher registers its destructor for this thread
+                    thread_local Flusher flusher;
+                    (void) flusher;
+                }
+                return s;
+            }
+        };
 
-        [[nodiscard]] T* allocate(std::size_t n)
-        {
-            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
-                throw std::bad_array_new_length();
+        // counters the override applies in batches dip below zero for a moment when a thread applies its frees of blocks
+        // another thread has not applied yet, they read as 0 then
+        static size_t settled(size_t value) {
+            return static_cast<ptrdiff_t>(value) < 0 ? 0 : value;
+        }
 
-            auto & singleton = GET_SINGLETONS();
-            singleton.mutex.lock();
-            void * ptr;
-            while (true) {
-                // calloc initializes memory and stops valgrind complaining about uninitialized memory use
-                ptr = SINGLETONS::inspect_calloc(n, sizeof(T));
-                if (ptr == nullptr) {
-                    auto handler = std::get_new_handler();
-                    if (handler == nullptr) {
-                        throw std::bad_alloc();
-                    } else {
-                        handler();
-                        continue;
-                    }
-                } else {
-                    break;
-                }
+        // bytes is what the caller asked for, metadata the rest of the block
+        void account_unlisted_alloc(size_t bytes, size_t metadata) {
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ACCOUNT_ALLOC, nullptr, bytes, TYPE_TABLE::index_of<uint8_t>());
+            UNLISTED_BATCH::ThreadState & s = UNLISTED_BATCH::starting();
+            s.objects++;
+            s.bytes += static_cast<ptrdiff_t>(bytes);
+            s.metadata += static_cast<ptrdiff_t>(metadata);
+            s.allocated += bytes;
+            if (++s.operations >= UNLISTED_BATCH::batch || s.bytes >= static_cast<ptrdiff_t>(UNLISTED_BATCH::batch_bytes) || s.dead) {
+                flush_unlisted();
             }
-            singleton.memory_usage += sizeof(T)*n;
-            singleton.per_type<T>().memory_usage += sizeof(T)*n;
-            if (log) {
-                Logib();
-                printf("allocated %zu bytes of memory, total memory usage for '%s': %zu bytes. total memory usage: %zu bytes\n", sizeof(T)*n, singleton.per_type<T>().demangled, singleton.per_type<T>().memory_usage, singleton.memory_usage);
-                Logr();
+        }
+
+        void account_unlisted_free(size_t bytes, size_t metadata) {
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ACCOUNT_FREE, nullptr, bytes, TYPE_TABLE::index_of<uint8_t>());
+            UNLISTED_BATCH::ThreadState & s = UNLISTED_BATCH::starting();
+            s.objects--;
+            s.bytes -= static_cast<ptrdiff_t>(bytes);
+            s.metadata -= static_cast<ptrdiff_t>(metadata);
+            if (++s.operations >= UNLISTED_BATCH::batch || s.bytes <= -static_cast<ptrdiff_t>(UNLISTED_BATCH::batch_bytes) || s.dead) {
+                flush_unlisted();
             }
-            onAlloc(static_cast<T*>(ptr), sizeof(T)*n);
-            singleton.mutex.unlock();
-            return static_cast<T*>(ptr);
         }
-    
-        void secure_free(T* p, std::size_t n) noexcept
-        {
-            // the compiler is not allowed to optimize out functions that use volatile pointers
-            volatile uint8_t* s = reinterpret_cast<uint8_t*>(p);
-            volatile uint8_t* e = s + (sizeof(T)*n);
-            std::fill(s, e, 0);
-            SINGLETONS::inspect_free(p);
-            auto & singleton = GET_SINGLETONS();
-            singleton.memory_usage -= sizeof(T)*n;
-            singleton.per_type<T>().memory_usage -= sizeof(T)*n;
+
+        // applies what the calling thread accounted for the operator new override so far
+        void flush_unlisted() {
+            UNLISTED_BATCH::ThreadState & s = UNLISTED_BATCH::state();
+            if (s.objects != 0 || s.bytes != 0 || s.allocated != 0) {
+                memory_usage.apply(s.bytes, s.allocated);
+                per_type_slot<uint8_t>().memory_usage.apply(s.bytes, s.allocated);
+                metadata_usage.fetch_add(static_cast<size_t>(s.metadata), std::memory_order_relaxed);
+                tracked_objects.fetch_add(static_cast<size_t>(s.objects), std::memory_order_relaxed);
+                unlisted_objects.fetch_add(static_cast<size_t>(s.objects), std::memory_order_relaxed);
+                unlisted_bytes.fetch_add(static_cast<size_t>(s.bytes), std::memory_order_relaxed);
+            }
+            s.objects = 0;
+            s.bytes = 0;
+            s.metadata = 0;
+            s.allocated = 0;
+            s.operations = 0;
         }
 
-        void deallocate(T* p, std::size_t n) noexcept
-        {
-            if (log) {
-                Logib();
-                printf("deallocate called with p = %p, n = %zu\n", p, n);
-                Logr();
+        // the table lookup runs once per type, the entry lives as long as the singleton does
+        template <typename T>
+        PER_TYPE<T> & per_type_slot() {
+            static PER_TYPE<T> & slot = [this]() -> PER_TYPE<T> & {
+                std::lock_guard<std::recursive_mutex> guard(stats_mutex);
+                return per_type_table.get<T>();
+            }();
+            return slot;
+        }
+
+        // the owners of a tracked pointer, almost always one or two so they are kept inline and only spill to an array
+        // when more allocators share the pointer
+        //
+        // every owner is an OWNER_HANDLE, the global allocator's is always kept in the first slot so checking for it only
+        // looks at that slot
+        struct PTR_OWNERS {
+            static constexpr size_t inline_capacity = 2;
+
+            size_t size = 0;
+            size_t spill_capacity = 0;
+            void * owners[inline_capacity] = {};
+            void ** spill = nullptr;
+
+            // one per record, the REF and UNREF events already trace them
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(PTR_OWNERS, PTR_OWNERS);
+
+            PTR_OWNERS() = default;
+
+            void *& at(size_t i) {
+                return i < inline_capacity ? owners[i] : spill[i - inline_capacity];
             }
-            if (p == nullptr) {
-                return;
+
+            bool contains(void * owner) {
+                if (owners[0] == owner && size != 0) return true;
+                if (owners[1] == owner && size > 1) return true;
+                for (size_t i = inline_capacity; i < size; i++) {
+                    if (spill[i - inline_capacity] == owner) return true;
+                }
+                return false;
+            }
+
+            bool owned_by_global() {
+                return size != 0 && static_cast<OWNER_HANDLE*>(owners[0])->global;
+            }
+
+            // returns false if owner was already present
+            bool add(void * owner) {
+                if (contains(owner)) {
+                    return false;
+                }
+                if (size >= inline_capacity && size - inline_capacity == spill_capacity) {
+                    size_t wanted = spill_capacity == 0 ? 4 : spill_capacity * 2;
+                    void ** grown = static_cast<void**>(inspect_calloc(wanted, sizeof(void*)));
+                    if (grown == nullptr) {
+                        throw std::bad_alloc();
+                    }
+                    for (size_t i = 0; i < spill_capacity; i++) {
+                        grown[i] = spill[i];
+                    }
+                    inspect_free(spill);
+                    spill = grown;
+                    spill_capacity = wanted;
+                }
+                at(size++) = owner;
+                if (size != 1 && static_cast<OWNER_HANDLE*>(owner)->global) {
+                    std::swap(owners[0], at(size - 1));
+                }
+                return true;
+            }
+
+            // returns false if owner was not present
+            bool remove(void * owner) {
+                for (size_t i = 0; i < size; i++) {
+                    if (at(i) == owner) {
+                        at(i) = at(size - 1);
+                        at(--size) = nullptr;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void remove_all_except(void * owner) {
+                bool kept = contains(owner);
+                clear();
+                if (kept) {
+                    owners[0] = owner;
+                    size = 1;
+                }
+            }
+
+            void clear() {
+                inspect_free(spill);
+                spill = nullptr;
+                spill_capacity = 0;
+                owners[0] = nullptr;
+                owners[1] = nullptr;
+                size = 0;
+            }
+
+            // bytes allocated outside the record
+            size_t heap_bytes() const {
+                return spill_capacity * sizeof(void*);
+            }
+
+            ~PTR_OWNERS() {
+                inspect_free(spill);
+            }
+        };
+
+        // splits a pointer keyed index into address hashed shards, each guarded by its own lock
+        template <typename INDEX>
+        struct SA__Sharded {
+            static constexpr size_t shard_count = SA_STACK_ALLOCATOR__SHARDS;
+            static_assert(shard_count != 0 && (shard_count & (shard_count - 1)) == 0, "SA_STACK_ALLOCATOR__SHARDS must be a power of two");
+
+            // one cache line per shard so neighbouring locks do not false share
+            struct alignas(64) Shard {
+                std::mutex mutex;
+                INDEX index;
+            };
+
+            Shard shards[shard_count];
+
+            static size_t shard_index(void * ptr) {
+                // the index consumes the low bits of the hash, select the shard from the high bits
+                size_t h = SA__PointerMap<bool>::hash(ptr);
+                return (h >> (sizeof(size_t) * 8 - 16)) & (shard_count - 1);
+            }
+
+            Shard & shard_for(void * ptr) {
+                return shards[shard_index(ptr)];
+            }
+
+            // the non null pointers of a batch sorted by shard so every shard is locked once per batch, the pointers of
+            // shard s are ptrs[order[first[s]]] .. ptrs[order[first[s + 1] - 1]]
+            struct Batch {
+                size_t * order = nullptr;
+                size_t first[shard_count + 1] = {};
+
+                Batch(void * const * ptrs, size_t count) {
+                    if (count == 0) return;
+                    order = static_cast<size_t*>(inspect_calloc(count, sizeof(size_t)));
+                    if (order == nullptr) throw std::bad_alloc();
+                    for (size_t i = 0; i < count; i++) {
+                        if (ptrs[i] != nullptr) {
+                            first[shard_index(ptrs[i]) + 1]++;
+                        }
+                    }
+                    for (size_t s = 0; s < shard_count; s++) {
+                        first[s + 1] += first[s];
+                    }
+                    size_t next[shard_count];
+                    for (size_t s = 0; s < shard_count; s++) {
+                        next[s] = first[s];
+                    }
+                    for (size_t i = 0; i < count; i++) {
+                        if (ptrs[i] != nullptr) {
+                            order[next[shard_index(ptrs[i])]++] = i;
+                        }
+                    }
+                }
+
+                Batch(const Batch & other) = delete;
+                Batch & operator=(const Batch & other) = delete;
+
+                ~Batch() {
+                    inspect_free(order);
+                }
+            };
+        };
+
+        struct PTR_INDEX : private SA__PointerMap<bool> {
+            using SA__PointerMap<bool>::size;
+            SA____STACK_ALLOCATOR__REF_ONLY(PTR_INDEX, PTR_INDEX);
+
+            void add_pointer(void * p) {
+                bool found;
+                find_or_add(p, found) = true;
+            }
+
+            bool contains(void * p) {
+                return find(p) != nullptr;
+            }
+
+            bool remove_pointer(void * p) {
+                if (remove(p)) {
+                    if (log) {
+                        Logeb();
+                        printf("REMOVE: found tracked pointer %p\n", p);
+                        Logr();
+                    }
+                    return true;
+                }
+                if (p != nullptr) {
+                    Logeb();
+                    printf("REMOVE: COULD NOT FIND TRACKED POINTER %p\n", p);
+                    Logr();
+                }
+                return false;
+            }
+        };
+
+        struct PTR_REGISTRY : private SA__Sharded<PTR_INDEX> {
+            SA____STACK_ALLOCATOR__REF_ONLY(PTR_REGISTRY, PTR_REGISTRY);
+
+            void add_pointer(void * p) {
+                auto & shard = shard_for(p);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                shard.index.add_pointer(p);
+            }
+
+            bool contains(void * p) {
+                auto & shard = shard_for(p);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                return shard.index.contains(p);
+            }
+
+            bool remove_pointer(void * p) {
+                auto & shard = shard_for(p);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                return shard.index.remove_pointer(p);
+            }
+        };
+
+        // these are used by TrackedMallocator
+        PTR_REGISTRY pointers;
+
+        struct OWNER_INDEX : private SA__PointerMap<void(*)(void*, void*)> {
+            using SA__PointerMap<void(*)(void*, void*)>::remove;
+            SA____STACK_ALLOCATOR__REF_ONLY(OWNER_INDEX, OWNER_INDEX);
+
+            void add(void * owner, void (*disown)(void*, void*)) {
+                bool found;
+                find_or_add(owner, found) = disown;
+            }
+
+            void (*disown_of(void * owner))(void*, void*) {
+                auto * p = find(owner);
+                return p == nullptr ? nullptr : *p;
+            }
+        };
+
+        // allocators that keep a set of the registry records they reference register how to take a pointer out of it,
+        // release() drops every owner of a pointer at once and tells each of them through this
+        struct OWNER_DIRECTORY : private SA__Sharded<OWNER_INDEX> {
+            SA____STACK_ALLOCATOR__REF_ONLY(OWNER_DIRECTORY, OWNER_DIRECTORY);
+
+            void add(void * owner, void (*disown)(void*, void*)) {
+                auto & shard = shard_for(owner);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                shard.index.add(owner, disown);
+            }
+
+            void remove(void * owner) {
+                auto & shard = shard_for(owner);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                shard.index.remove(owner);
+            }
+
+            // the caller holds the registry shard lock of ptr, so an owner still listed in its record is alive
+            void notify(void * owner, void * ptr) {
+                void (*disown)(void*, void*);
+                {
+                    auto & shard = shard_for(owner);
+                    std::lock_guard<std::mutex> guard(shard.mutex);
+                    disown = shard.index.disown_of(owner);
+                }
+                if (disown != nullptr) {
+                    disown(owner, ptr);
+                }
+            }
+        };
+
+        // declared ahead of the registry so it outlives it
+        OWNER_DIRECTORY owner_directory;
+
+        // the usage of one allocator that keeps its own statistics, listed in the usage directory for as long as the
+        // allocator lives
+        struct ALLOCATOR_USAGE {
+            USAGE_COUNTER counter;
+            const void * allocator = nullptr;
+            ALLOCATOR_USAGE * prev = nullptr;
+            ALLOCATOR_USAGE * next = nullptr;
+        };
+
+        // only allocators coming and going and snapshot() take the lock, accounting goes straight to the counters
+        struct USAGE_DIRECTORY {
+            std::mutex mutex;
+            ALLOCATOR_USAGE * head = nullptr;
+            size_t count = 0;
+
+            SA____STACK_ALLOCATOR__REF_ONLY(USAGE_DIRECTORY, USAGE_DIRECTORY);
+
+            void add(ALLOCATOR_USAGE & u, const void * allocator) {
+                std::lock_guard<std::mutex> guard(mutex);
+                u.allocator = allocator;
+                u.prev = nullptr;
+                u.next = head;
+                if (head != nullptr) {
+                    head->prev = &u;
+                }
+                head = &u;
+                count++;
+            }
+
+            void remove(ALLOCATOR_USAGE & u) {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (u.prev != nullptr) {
+                    u.prev->next = u.next;
+                } else {
+                    head = u.next;
+                }
+                if (u.next != nullptr) {
+                    u.next->prev = u.prev;
+                }
+                u.prev = nullptr;
+                u.next = nullptr;
+                count--;
+            }
+        };
+
+        USAGE_DIRECTORY allocator_usage;
+
+        // the handles of the allocators that listed a header allocation, such an allocation is only known to its
+        // allocator's list, so write_report reaches it through here, an allocator joins with its first listed
+        // allocation and leaves when it is destroyed or spliced
+        struct ALLOCATOR_DIRECTORY {
+            std::mutex mutex;
+            OWNER_HANDLE * head = nullptr;
+
+            SA____STACK_ALLOCATOR__REF_ONLY(ALLOCATOR_DIRECTORY, ALLOCATOR_DIRECTORY);
+
+            void add(OWNER_HANDLE * h, void (*count_listed)(OWNER_HANDLE*, size_t&, size_t&)) {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (h->live.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                h->count_listed = count_listed;
+                h->prev_live = nullptr;
+                h->next_live = head;
+                if (head != nullptr) {
+                    head->prev_live = h;
+                }
+                head = h;
+                h->live.store(true, std::memory_order_relaxed);
+            }
+
+            void remove(OWNER_HANDLE * h) {
+                if (!h->live.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                std::lock_guard<std::mutex> guard(mutex);
+                if (h->prev_live != nullptr) {
+                    h->prev_live->next_live = h->next_live;
+                } else {
+                    head = h->next_live;
+                }
+                if (h->next_live != nullptr) {
+                    h->next_live->prev_live = h->prev_live;
+                }
+                h->prev_live = nullptr;
+                h->next_live = nullptr;
+                h->live.store(false, std::memory_order_relaxed);
+            }
+        };
+
+        ALLOCATOR_DIRECTORY live_allocators;
+
+        // thread local caches of zeroed blocks grouped by size class
+        //
+        // blocks are created and registered with pointers in batches, then move between a thread's magazine and the
+        // shared depot of their class in batches, so the common alloc/dealloc pair only touches thread local state
+        //
+        // a block is wiped before it is cached, cached blocks are always zero just like a fresh calloc
+        struct MAGAZINES {
+            SA____STACK_ALLOCATOR__REF_ONLY(MAGAZINES, MAGAZINES);
+
+            static constexpr size_t granularity = 16;
+            static constexpr size_t max_size = SA_STACK_ALLOCATOR__MAGAZINE_MAX_SIZE;
+            static constexpr size_t class_count = max_size / granularity == 0 ? 1 : max_size / granularity;
+            // every class has a second slot at class_count + class for the raw blocks of the operator new override,
+            // which are neither zeroed when freed nor handed out zeroed, so they never mix with the zeroed ones
+            static constexpr size_t slot_count = class_count * 2;
+            static constexpr size_t capacity = 64;
+            static constexpr size_t batch = capacity / 2;
+            static constexpr size_t depot_limit = SA_STACK_ALLOCATOR__MAGAZINE_DEPOT_LIMIT * capacity;
+
+            struct Magazine {
+                size_t count;
+                void * blocks[capacity];
+            };
+
+            // trivially destructible so it stays usable after the Drainer below has run at thread exit
+            struct ThreadState {
+                Magazine * magazines;
+                bool dead;
+            };
+
+            struct Drainer {
+                ~Drainer() {
+                    ThreadState & s = state();
+                    if (s.magazines != nullptr) {
+                        auto & m = GET_SINGLETONS().magazines;
+                        for (size_t c = 0; c < slot_count; c++) {
+                            m.drain(c, s.magazines[c], s.magazines[c].count);
+                        }
+                        inspect_free(s.magazines);
+                        s.magazines = nullptr;
+                    }
+                    // anything freed on this thread from now on goes straight to the depot
+                    s.dead = true;
+                }
+            };
+
+            struct alignas(64) Depot {
+                std::mutex mutex;
+                // free blocks are chained through their first word
+                void * head = nullptr;
+                size_t count = 0;
+            };
+
+            Depot depots[slot_count];
+
+            // bytes held by blocks this layer created and has not yet returned to the system, handed out or cached
+            std::atomic<size_t> reserved_usage {0};
+
+            static ThreadState & state() {
+                thread_local ThreadState s;
+                return s;
+            }
+
+            static bool eligible(size_t size, size_t alignment) {
+                return size != 0 && size <= max_size && alignment <= alignof(std::max_align_t);
+            }
+
+            static size_t class_of(size_t size) {
+                return (size - 1) / granularity;
+            }
+
+            static size_t slot_of(size_t size, bool raw) {
+                return class_of(size) + (raw ? class_count : 0);
+            }
+
+            static size_t block_size(size_t c) {
+                return (c % class_count + 1) * granularity;
+            }
+
+            Magazine * magazine(size_t c) {
+                ThreadState & s = state();
+                if (s.magazines == nullptr) {
+                    if (s.dead) return nullptr;
+                    s.magazines = static_cast<Magazine*>(inspect_calloc(slot_count, sizeof(Magazine)));
+                    if (s.magazines == nullptr) return nullptr;
+                    // touching the drainer registers its destructor for this thread
+                    thread_local Drainer drainer;
+                    (void) drainer;
+                }
+                return &s.magazines[c];
+            }
+
+            // moves up to wanted blocks from the depot into m, creating new blocks if the depot is empty
+            void refill(size_t c, Magazine & m, size_t wanted) {
+                Depot & d = depots[c];
+                {
+                    std::lock_guard<std::mutex> guard(d.mutex);
+                    while (wanted != 0 && d.head != nullptr) {
+                        void * block = d.head;
+                        d.head = *static_cast<void**>(block);
+                        *static_cast<void**>(block) = nullptr;
+                        d.count--;
+                        m.blocks[m.count++] = block;
+                        wanted--;
+                    }
+                }
+                if (wanted != 0) {
+                    size_t created = 0;
+                    auto & pointers = GET_SINGLETONS().pointers;
+                    while (wanted != 0) {
+                        void * block = inspect_calloc(1, block_size(c));
+                        if (block == nullptr) break;
+                        pointers.add_pointer(block);
+                        m.blocks[m.count++] = block;
+                        wanted--;
+                        created++;
+                    }
+                    reserved_usage.fetch_add(created * block_size(c), std::memory_order_relaxed);
+                }
+            }
+
+            // moves the top count blocks of m into the depot, a depot that grew past depot_limit after a burst gives
+            // everything above half of it back to the system
+            void drain(size_t c, Magazine & m, size_t count) {
+                if (count == 0) return;
+                Depot & d = depots[c];
+                void * excess = nullptr;
+                size_t excess_count = 0;
+                {
+                    std::lock_guard<std::mutex> guard(d.mutex);
+                    while (count != 0) {
+                        void * block = m.blocks[--m.count];
+                        *static_cast<void**>(block) = d.head;
+                        d.head = block;
+                        d.count++;
+                        count--;
+                    }
+                    if (depot_limit != 0 && d.count > depot_limit) {
+                        excess_count = d.count - depot_limit / 2;
+                        excess = d.head;
+                        void * last = excess;
+                        for (size_t i = 1; i < excess_count; i++) {
+                            last = *static_cast<void**>(last);
+                        }
+                        d.head = *static_cast<void**>(last);
+                        *static_cast<void**>(last) = nullptr;
+                        d.count -= excess_count;
+                    }
+                }
+                if (excess != nullptr) {
+                    release_blocks(c, excess, excess_count);
+                }
+            }
+
+            // frees a chain of count depot blocks of class c, called with no depot lock held
+            void release_blocks(size_t c, void * head, size_t count) {
+                auto & pointers = GET_SINGLETONS().pointers;
+                while (head != nullptr) {
+                    void * next = *static_cast<void**>(head);
+                    pointers.remove_pointer(head);
+                    inspect_free(head);
+                    head = next;
+                }
+                reserved_usage.fetch_sub(count * block_size(c), std::memory_order_relaxed);
+            }
+
+            // raw asks for a block of the override's slot, its contents are whatever the last user left
+            void * alloc(size_t size, bool raw = false) {
+                size_t c = slot_of(size, raw);
+                Magazine * m = magazine(c);
+                if (m != nullptr) {
+                    if (m->count == 0) {
+                        refill(c, *m, batch);
+                    }
+                    return m->count == 0 ? nullptr : m->blocks[--m->count];
+                }
+                // this thread has exited its magazines, go through the depot directly
+                Magazine single;
+                single.count = 0;
+                refill(c, single, 1);
+                return single.count == 0 ? nullptr : single.blocks[0];
+            }
+
+            // returns a block alloc handed out straight to the system instead of caching it
+            void discard(void * p, size_t size) {
+                GET_SINGLETONS().pointers.remove_pointer(p);
+                inspect_free(p);
+                reserved_usage.fetch_sub(block_size(class_of(size)), std::memory_order_relaxed);
+            }
+
+            // blocks are handed out zeroed, WipePolicy decides how, a raw block goes back to the override's slot as it is
+            template <typename WipePolicy = FastWipe>
+            void free(void * p, size_t size, bool raw = false) {
+                if (!raw) {
+                    WipePolicy::zero(p, size);
+                }
+                size_t c = slot_of(size, raw);
+                Magazine * m = magazine(c);
+                if (m != nullptr) {
+                    if (m->count == capacity) {
+                        drain(c, *m, batch);
+                    }
+                    m->blocks[m->count++] = p;
+                    return;
+                }
+                Magazine single;
+                single.count = 1;
+                single.blocks[0] = p;
+                drain(c, single, 1);
+            }
+
+            // returns every depot block to the system, blocks still cached by live threads are left alone
+            void trim() {
+                for (size_t c = 0; c < slot_count; c++) {
+                    Depot & d = depots[c];
+                    void * head;
+                    size_t count;
+                    {
+                        std::lock_guard<std::mutex> guard(d.mutex);
+                        head = d.head;
+                        count = d.count;
+                        d.head = nullptr;
+                        d.count = 0;
+                    }
+                    release_blocks(c, head, count);
+                }
+            }
+
+            ~MAGAZINES() {
+                trim();
+            }
+        };
+
+        MAGAZINES magazines;
+
+        // a tracked pointer
+        //
+        // destroy is called once when the record dies and interprets the context word, it is nullptr when there is
+        // nothing to run, it must check pointer since release() hands the pointer back without destroying it
+        struct PointerInfo {
+            SA____STACK_ALLOCATOR__REF_ONLY_NO_DEFAULT_CONSTRUCTOR(PointerInfo, PointerInfo);
+            PointerInfo() = default;
+            void * pointer = nullptr;
+            std::size_t count = 0;
+            void (*destroy)(PointerInfo & info) = nullptr;
+            union {
+                // the allocating TrackedAllocator or the bound state of a stateful deleter
+                void * context = nullptr;
+                // a plain function deleter of an adopted pointer
+                void (*deleter)(void*);
+            };
+            bool adopted = false;
+            // sizeof the element type, 0 when the pointer was adopted as void, size * count is the size of the object
+            uint32_t size = 0;
+            PTR_OWNERS refs;
+
+            void release() {
+                pointer = nullptr;
+                adopted = false;
+                count = 0;
+            }
+
+            // the context of a record allocated by a BasicAllocator is that allocator, once it no longer references the
+            // record the destroy function must not reach it, the context of any other record is never an owner
+            void forget_owner(void * owner) {
+                if (!adopted && context == owner) {
+                    context = nullptr;
+                }
+            }
+
+            ~PointerInfo() {
+                if (destroy != nullptr) {
+                    destroy(*this);
+                }
+                auto & singleton = GET_SINGLETONS();
+                singleton.metadata_usage.fetch_sub(sizeof(PointerInfo) + refs.heap_bytes(), std::memory_order_relaxed);
+                singleton.tracked_objects.fetch_sub(1, std::memory_order_relaxed);
+            }
+        };
+
+        // a single shard of the tracked pointer registry, the caller holds the shard lock
+        //
+        // records are never destroyed here, they are unlinked and handed back so the caller can run the destructor after
+        // dropping the lock, destructors are free to re-enter the registry from any shard
+        struct PTRINFO_INDEX : private SA__PointerMap<PointerInfo*> {
+            using SA__PointerMap<PointerInfo*>::size;
+            using SA__PointerMap<PointerInfo*>::remove;
+            using SA__PointerMap<PointerInfo*>::reserve;
+            SA____STACK_ALLOCATOR__REF_ONLY(PTRINFO_INDEX, PTRINFO_INDEX);
+
+            // the records of this shard, carved under the shard lock so the shards never meet on a shared pool
+            NODE_POOL records {sizeof(PointerInfo)};
+
+            static void warn_ptr(const char * tag, void * ptr) {
+                if (ptr != nullptr) {
+                    Logeb();
+                    printf("%s: COULD NOT FIND TRACKED POINTER %p\n", tag, ptr);
+                    Logr();
+                    // abort();
+                }
+            }
+
+            PointerInfo * find_info(void * ptr) {
+                PointerInfo ** p = find(ptr);
+                return p == nullptr ? nullptr : *p;
+            }
+
+            PointerInfo & ref(void * ptr, void * owner) {
+                bool f = false;
+                PointerInfo *& p = find_or_add(ptr, f);
+                if (!f) {
+                    p = alloc_from<PointerInfo>(records);
+                    p->pointer = ptr;
+                    auto & singleton = GET_SINGLETONS();
+                    singleton.metadata_usage.fetch_add(sizeof(PointerInfo), std::memory_order_relaxed);
+                    singleton.tracked_objects.fetch_add(1, std::memory_order_relaxed);
+                }
+                PointerInfo * info = p;
+                size_t owner_bytes = info->refs.heap_bytes();
+                if (info->refs.add(owner)) {
+                    GET_SINGLETONS().metadata_usage.fetch_add(info->refs.heap_bytes() - owner_bytes, std::memory_order_relaxed);
+                    SA____STACK_ALLOCATOR__EVENT(EVENT::REF, ptr, 0, EVENT::no_type, owner);
+                }
+                return *info;
+            }
+
+            // tells every owner but the global one that it no longer references ptr
+            static void notify_owners(void * ptr, PTR_OWNERS & refs) {
+                auto & directory = GET_SINGLETONS().owner_directory;
+                for (size_t i = refs.owned_by_global() ? 1 : 0; i < refs.size; i++) {
+                    directory.notify(refs.at(i), ptr);
+                }
+            }
+
+            // returns the unlinked record if it must be destroyed
+            PointerInfo * release(void * ptr, bool & released) {
+                released = false;
+                PointerInfo * info = find_info(ptr);
+                if (info != nullptr) {
+                    SA____STACK_ALLOCATOR__EVENT(EVENT::RELEASE, ptr);
+                    notify_owners(ptr, info->refs);
+                    // dont release if owned by global
+                    if (info->refs.owned_by_global()) {
+                        if (info->refs.size != 1) {
+                            for (size_t i = 1; i < info->refs.size; i++) {
+                                info->forget_owner(info->refs.at(i));
+                            }
+                            size_t owner_bytes = info->refs.heap_bytes();
+                            info->refs.remove_all_except(info->refs.owners[0]);
+                            GET_SINGLETONS().metadata_usage.fetch_sub(owner_bytes - info->refs.heap_bytes(), std::memory_order_relaxed);
+                            released = true;
+                        }
+                        return nullptr;
+                    } else {
+                        // we are not owned by global, it is safe to release
+                        remove(ptr);
+                        info->release();
+                        released = true;
+                        return info;
+                    }
+                }
+                warn_ptr("RELEASE", ptr);
+                return nullptr;
+            }
+
+            // returns the unlinked record if owner held the last reference to it
+            PointerInfo * unref(void * ptr, void * owner, bool & found, bool warn_not_found) {
+                PointerInfo * info = find_info(ptr);
+                found = info != nullptr;
+                if (info != nullptr) {
+                    if (info->refs.contains(owner)) {
+                        SA____STACK_ALLOCATOR__EVENT(EVENT::UNREF, ptr, 0, EVENT::no_type, owner);
+                        if (info->refs.size == 1) {
+                            remove(ptr);
+                            return info;
+                        } else {
+                            info->forget_owner(owner);
+                            size_t owner_bytes = info->refs.heap_bytes();
+                            info->refs.remove(owner);
+                            GET_SINGLETONS().metadata_usage.fetch_sub(owner_bytes - info->refs.heap_bytes(), std::memory_order_relaxed);
+                        }
+                    }
+                } else if (warn_not_found) {
+                    warn_ptr("UNREF", ptr);
+                }
+                return nullptr;
+            }
+
+            template <typename F>
+            void visit(F f) {
+                for_each([&](void * key, PointerInfo * info) {
+                    f(*info);
+                });
+            }
+
+            // fills out with every pointer owner references, returns the number of pointers written
+            size_t collect(void * owner, void ** out) {
+                size_t count = 0;
+                for_each([&](void * key, PointerInfo * info) {
+                    if (owner == nullptr || info->refs.contains(owner)) {
+                        out[count++] = key;
+                    }
+                });
+                return count;
+            }
+        };
+
+        struct PTRINFO_REGISTRY : private SA__Sharded<PTRINFO_INDEX> {
+            SA____STACK_ALLOCATOR__REF_ONLY(PTRINFO_REGISTRY, PTRINFO_REGISTRY);
+
+            // invokes f with the record under the shard lock
+            template <typename F>
+            void ref(void * ptr, void * owner, F f) {
+                auto & shard = shard_for(ptr);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                f(shard.index.ref(ptr, owner));
+            }
+
+            bool release(void * ptr) {
+                auto & shard = shard_for(ptr);
+                bool released;
+                PointerInfo * info;
+                {
+                    std::lock_guard<std::mutex> guard(shard.mutex);
+                    info = shard.index.release(ptr, released);
+                }
+                if (info != nullptr) {
+                    dealloc(&info);
+                }
+                return released;
+            }
+
+            // returns true if ptr is tracked, regardless of whether owner held a reference to it
+            bool unref(void * ptr, void * owner, bool warn_not_found = true) {
+                auto & shard = shard_for(ptr);
+                bool found;
+                PointerInfo * info;
+                {
+                    std::lock_guard<std::mutex> guard(shard.mutex);
+                    info = shard.index.unref(ptr, owner, found, warn_not_found);
+                }
+                if (info != nullptr) {
+                    // unlinked before destroying, the destructor may re-enter the registry
+                    dealloc(&info);
+                }
+                return found;
+            }
+
+            // like ref, but first references ptr from first_owner when non null, both under a single lock
+            template <typename F>
+            void share(void * ptr, void * first_owner, void * owner, F f) {
+                auto & shard = shard_for(ptr);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                if (first_owner != nullptr) {
+                    shard.index.ref(ptr, first_owner);
+                }
+                f(shard.index.ref(ptr, owner));
+            }
+
+            // the batched forms below take every shard lock once for the whole batch, nullptr entries are skipped
+
+            // invokes f(i, record) under the shard lock for every ptrs[i], the index of each shard grows at most once
+            template <typename F>
+            void ref_many(void * const * ptrs, size_t count, void * owner, F f) {
+                Batch batch(ptrs, count);
+                for (size_t s = 0; s < shard_count; s++) {
+                    size_t begin = batch.first[s];
+                    size_t end = batch.first[s + 1];
+                    if (begin == end) continue;
+                    auto & shard = shards[s];
+                    std::lock_guard<std::mutex> guard(shard.mutex);
+                    shard.index.reserve(shard.index.size + (end - begin));
+                    for (size_t k = begin; k < end; k++) {
+                        size_t i = batch.order[k];
+                        f(i, shard.index.ref(ptrs[i], owner));
+                    }
+                }
+            }
+
+            // the unlinked records of each shard are destroyed after its lock is dropped, like unref
+            void unref_many(void * const * ptrs, size_t count, void * owner, bool warn_not_found = true) {
+                Batch batch(ptrs, count);
+                PointerInfo ** infos = nullptr;
+                for (size_t s = 0; s < shard_count; s++) {
+                    size_t begin = batch.first[s];
+                    size_t end = batch.first[s + 1];
+                    if (begin == end) continue;
+                    if (infos == nullptr) {
+                        infos = static_cast<PointerInfo**>(inspect_calloc(count, sizeof(PointerInfo*)));
+                        if (infos == nullptr) throw std::bad_alloc();
+                    }
+                    size_t unlinked = unlink_shard(batch, s, ptrs, owner, warn_not_found, infos);
+                    for (size_t k = 0; k < unlinked; k++) {
+                        dealloc(&infos[k]);
+                    }
+                }
+                inspect_free(infos);
+            }
+
+            // like unref_many, but the records owner held the last reference to are only unlinked, they are written to
+            // out, which holds count entries, and the caller destroys them with dealloc, returns how many were written
+            size_t unlink_many(void * const * ptrs, size_t count, void * owner, PointerInfo ** out) {
+                Batch batch(ptrs, count);
+                size_t unlinked = 0;
+                for (size_t s = 0; s < shard_count; s++) {
+                    if (batch.first[s] != batch.first[s + 1]) {
+                        unlinked += unlink_shard(batch, s, ptrs, owner, false, out + unlinked);
+                    }
+                }
+                return unlinked;
+            }
+
+            void release_many(void * const * ptrs, size_t count) {
+                Batch batch(ptrs, count);
+                PointerInfo ** infos = nullptr;
+                for (size_t s = 0; s < shard_count; s++) {
+                    size_t begin = batch.first[s];
+                    size_t end = batch.first[s + 1];
+                    if (begin == end) continue;
+                    if (infos == nullptr) {
+                        infos = static_cast<PointerInfo**>(inspect_calloc(count, sizeof(PointerInfo*)));
+                        if (infos == nullptr) throw std::bad_alloc();
+                    }
+                    auto & shard = shards[s];
+                    size_t unlinked = 0;
+                    {
+                        std::lock_guard<std::mutex> guard(shard.mutex);
+                        for (size_t k = begin; k < end; k++) {
+                            bool released;
+                            PointerInfo * info = shard.index.release(ptrs[batch.order[k]], released);
+                            if (info != nullptr) {
+                                infos[unlinked++] = info;
+                            }
+                        }
+                    }
+                    for (size_t k = 0; k < unlinked; k++) {
+                        dealloc(&infos[k]);
+                    }
+                }
+                inspect_free(infos);
+            }
+
+            // moves the references from holds on the given pointers to to, f(record) runs under the lock for each moved one
+            template <typename F>
+            void reown_many(void * const * ptrs, size_t count, void * from, void * to, F f) {
+                Batch batch(ptrs, count);
+                for (size_t s = 0; s < shard_count; s++) {
+                    size_t begin = batch.first[s];
+                    size_t end = batch.first[s + 1];
+                    if (begin == end) continue;
+                    auto & shard = shards[s];
+                    std::lock_guard<std::mutex> guard(shard.mutex);
+                    for (size_t k = begin; k < end; k++) {
+                        PointerInfo * info = shard.index.find_info(ptrs[batch.order[k]]);
+                        if (info != nullptr && info->refs.contains(from)) {
+                            size_t owner_bytes = info->refs.heap_bytes();
+                            info->refs.remove(from);
+                            info->refs.add(to);
+                            GET_SINGLETONS().metadata_usage.fetch_add(info->refs.heap_bytes() - owner_bytes, std::memory_order_relaxed);
+                            f(*info);
+                        }
+                    }
+                }
+            }
+
+            // invokes f with every record, one shard lock at a time, f must not enter the registry
+            template <typename F>
+            void visit(F f) {
+                for (auto & shard : shards) {
+                    std::lock_guard<std::mutex> guard(shard.mutex);
+                    shard.index.visit(f);
+                }
+            }
+
+            // returns true if ptr is tracked and owner holds the only reference to it
+            bool is_sole_owner(void * ptr, void * owner) {
+                auto & shard = shard_for(ptr);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                PointerInfo * info = shard.index.find_info(ptr);
+                return info != nullptr && info->refs.size == 1 && info->refs.contains(owner);
+            }
+
+            void unref_all(void * owner) {
+                for (auto & shard : shards) {
+                    // snapshot the owned pointers first, destructors may add or remove entries while we unref
+                    size_t count;
+                    void ** owned;
+                    {
+                        std::lock_guard<std::mutex> guard(shard.mutex);
+                        if (shard.index.size == 0) continue;
+                        owned = static_cast<void**>(inspect_calloc(shard.index.size, sizeof(void*)));
+                        if (owned == nullptr) throw std::bad_alloc();
+                        count = shard.index.collect(owner, owned);
+                    }
+                    for (size_t i = 0; i < count; i++) {
+                        // an earlier destructor may have already deallocated this pointer
+                        unref(owned[i], owner, false);
+                    }
+                    inspect_free(owned);
+                }
+            }
+
+            private:
+
+            size_t unlink_shard(Batch & batch, size_t s, void * const * ptrs, void * owner, bool warn_not_found, PointerInfo ** out) {
+                auto & shard = shards[s];
+                size_t unlinked = 0;
+                std::lock_guard<std::mutex> guard(shard.mutex);
+                for (size_t k = batch.first[s]; k < batch.first[s + 1]; k++) {
+                    bool found;
+                    PointerInfo * info = shard.index.unref(ptrs[batch.order[k]], owner, found, warn_not_found);
+                    if (info != nullptr) {
+                        out[unlinked++] = info;
+                    }
+                }
+                return unlinked;
+            }
+
+            public:
+
+            ~PTRINFO_REGISTRY() {
+                // destroy whatever is still tracked while every shard is still alive, destructors may re-enter any shard
+                bool remaining = true;
+                while (remaining) {
+                    remaining = false;
+                    for (auto & shard : shards) {
+                        size_t count;
+                        void ** keys;
+                        {
+                            std::lock_guard<std::mutex> guard(shard.mutex);
+                            if (shard.index.size == 0) continue;
+                            keys = static_cast<void**>(inspect_calloc(shard.index.size, sizeof(void*)));
+                            if (keys == nullptr) return;
+                            count = shard.index.collect(nullptr, keys);
+                        }
+                        remaining = true;
+                        for (size_t i = 0; i < count; i++) {
+                            PointerInfo * info = nullptr;
+                            {
+                                std::lock_guard<std::mutex> guard(shard.mutex);
+                                shard.index.remove(keys[i], &info);
+                            }
+                            if (info != nullptr) {
+                                dealloc(&info);
+                            }
+                        }
+                        inspect_free(keys);
+                    }
+                }
+            }
+        };
+
+        // these are used by the TrackedAllocator
+        PTRINFO_REGISTRY tracked_pointers;
+
+        SA____STACK_ALLOCATOR__REF_ONLY(SINGLETONS, SINGLETONS);
+
+        ~SINGLETONS() {
+            if (log) {
+                Logeb();
+                printf("~SINGLETONS()\n");
+                Logr();
+            }
+            // whatever is still tracked is destroyed along with the registry right after this
+            const char * path = getenv("SA_STACK_ALLOCATOR_LEAK_REPORT");
+            if (path != nullptr) {
+                write_report(path);
+            }
+#ifdef SA_STACK_ALLOCATOR__LOGGING
+            // the type names are written from our statistics
+            GET_EVENT_LOG().stop();
+#endif
+        }
+    };
+
+    // what GET_SINGLETONS().snapshot() returns, nothing is stopped while it is taken, every counter is read once so
+    // the parts of a snapshot may be a few allocations apart, type names live as long as the singletons
+    struct MemorySnapshot {
+        struct Type {
+            const char * name;
+            MemoryUsage usage;
+        };
+
+        // an SA::AllocatorWithMemUsage
+        struct Owner {
+            const void * allocator;
+            MemoryUsage usage;
+        };
+
+        MemoryUsage global = {};
+        Type * types = nullptr;
+        size_t type_count = 0;
+        Owner * allocators = nullptr;
+        size_t allocator_count = 0;
+
+        MemorySnapshot() = default;
+
+        MemorySnapshot(const MemorySnapshot & other) = delete;
+        MemorySnapshot & operator=(const MemorySnapshot & other) = delete;
+
+        MemorySnapshot(MemorySnapshot && other) noexcept {
+            *this = std::move(other);
+        }
+
+        MemorySnapshot & operator=(MemorySnapshot && other) noexcept {
+            std::swap(global, other.global);
+            std::swap(types, other.types);
+            std::swap(type_count, other.type_count);
+            std::swap(allocators, other.allocators);
+            std::swap(allocator_count, other.allocator_count);
+            return *this;
+        }
+
+        ~MemorySnapshot() {
+            SINGLETONS::inspect_free(types);
+            SINGLETONS::inspect_free(allocators);
+        }
+    };
+
+    inline void OWNER_HANDLE::release(OWNER_HANDLE * h) {
+        // the absorbed lists are walked as one chain by putting each in front of the siblings still to visit
+        while (h != nullptr) {
+            OWNER_HANDLE * next = h->sibling;
+            if (h->absorbed != nullptr) {
+                OWNER_HANDLE * last = h->absorbed;
+                while (last->sibling != nullptr) {
+                    last = last->sibling;
+                }
+                last->sibling = next;
+                next = h->absorbed;
+            }
+            if (h->pinned.load(std::memory_order_relaxed)) {
+                h->allocator = nullptr;
+                h->forward = nullptr;
+                h->absorbed = nullptr;
+                h->sibling = nullptr;
+                h->prev_sibling = nullptr;
+            } else {
+                SINGLETONS::dealloc(&h);
+            }
+            h = next;
+        }
+    }
+
+    inline MemorySnapshot SINGLETONS::snapshot() {
+        flush_unlisted();
+        MemorySnapshot s;
+        s.global = memory_usage.load();
+        {
+            std::lock_guard<std::recursive_mutex> guard(stats_mutex);
+            size_t count = 0;
+            per_type_table.for_each([&](TYPE_STATS &) { count++; });
+            if (count != 0) {
+                s.types = static_cast<MemorySnapshot::Type*>(inspect_calloc(count, sizeof(MemorySnapshot::Type)));
+                if (s.types == nullptr) throw std::bad_alloc();
+                per_type_table.for_each([&](TYPE_STATS & stats) {
+                    s.types[s.type_count++] = {stats.name(), stats.memory_usage.load()};
+                });
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(allocator_usage.mutex);
+            if (allocator_usage.count != 0) {
+                s.allocators = static_cast<MemorySnapshot::Owner*>(inspect_calloc(allocator_usage.count, sizeof(MemorySnapshot::Owner)));
+                if (s.allocators == nullptr) throw std::bad_alloc();
+                for (ALLOCATOR_USAGE * u = allocator_usage.head; u != nullptr; u = u->next) {
+                    s.allocators[s.allocator_count++] = {u->allocator, u->counter.load()};
+                }
+            }
+        }
+        return s;
+    }
+
+    // a JSON string, type names may hold anything
+    inline void write_json_string(FILE * file, const char * string) {
+        fputc('"', file);
+        for (const char * c = string; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                fputc('\\', file);
+                fputc(*c, file);
+            } else if (static_cast<unsigned char>(*c) < 0x20) {
+                fprintf(file, "\\u%04x", static_cast<unsigned char>(*c));
+            } else {
+                fputc(*c, file);
+            }
+        }
+        fputc('"', file);
+    }
+
+    inline bool SINGLETONS::write_report(const char * path) {
+        flush_unlisted();
+        struct Owner {
+            void * allocator;
+            bool global;
+            size_t objects;
+            size_t bytes;
+            size_t shared;
+        };
+        // the owners seen so far and their slot in owners
+        SA__PointerMap<size_t> slots;
+        Owner * owners = nullptr;
+        size_t owner_count = 0;
+        size_t owner_capacity = 0;
+        size_t records = 0;
+        bool failed = false;
+        // nullptr once growing owners failed
+        auto owner_of = [&](OWNER_HANDLE * owner) -> Owner * {
+            bool found;
+            size_t & slot = slots.find_or_add(owner, found);
+            if (!found) {
+                if (owner_count == owner_capacity) {
+                    size_t wanted = owner_capacity == 0 ? 64 : owner_capacity * 2;
+                    Owner * grown = static_cast<Owner*>(inspect_calloc(wanted, sizeof(Owner)));
+                    if (grown == nullptr) {
+                        failed = true;
+                        return nullptr;
+                    }
+                    if (owners != nullptr) {
+                        memcpy(grown, owners, owner_count * sizeof(Owner));
+                        inspect_free(owners);
+                    }
+                    owners = grown;
+                    owner_capacity = wanted;
+                }
+                slot = owner_count++;
+                owners[slot].allocator = owner->allocator;
+                owners[slot].global = owner->global;
+            }
+            return &owners[slot];
+        };
+        tracked_pointers.visit([&](PointerInfo & p) {
+            records++;
+            size_t bytes = static_cast<size_t>(p.size) * p.count;
+            for (size_t i = 0; i < p.refs.size && !failed; i++) {
+                // a spliced allocator's objects are reported under the allocator they were spliced into
+                Owner * o = owner_of(static_cast<OWNER_HANDLE*>(p.refs.at(i))->resolve());
+                if (o == nullptr) {
+                    return;
+                }
+                o->objects++;
+                o->bytes += bytes;
+                if (p.refs.size > 1) {
+                    o->shared++;
+                }
+            }
+        });
+        size_t unlisted = settled(unlisted_objects.load(std::memory_order_relaxed));
+        if (unlisted != 0 && global_owner != nullptr && !failed) {
+            Owner * o = owner_of(global_owner);
+            if (o != nullptr) {
+                o->objects += unlisted;
+                o->bytes += settled(unlisted_bytes.load(std::memory_order_relaxed));
+            }
+        }
+        {
+            // what never reached the registry is only in the header lists
+            std::lock_guard<std::mutex> guard(live_allocators.mutex);
+            for (OWNER_HANDLE * h = live_allocators.head; h != nullptr && !failed; h = h->next_live) {
+                size_t objects = 0;
+                size_t bytes = 0;
+                h->count_listed(h, objects, bytes);
+                if (objects != 0) {
+                    Owner * o = owner_of(h);
+                    if (o != nullptr) {
+                        o->objects += objects;
+                        o->bytes += bytes;
+                    }
+                }
+            }
+        }
+        FILE * file = failed ? nullptr : fopen(path, "w");
+        if (file == nullptr) {
+            inspect_free(owners);
+            return false;
+        }
+        std::sort(owners, owners + owner_count, [](const Owner & a, const Owner & b) { return a.bytes > b.bytes; });
+
+        MemoryUsage total = memory_usage.load();
+        fprintf(file, "{\n  \"memory_usage\": {\"current\": %zu, \"peak\": %zu, \"total\": %zu},\n", total.current, total.peak, total.total);
+        fprintf(file, "  \"metadata\": {\"in_use\": %zu, \"reserved\": %zu},\n", settled(metadata_usage.load()), metadata_reserved.load());
+        fprintf(file, "  \"tracked_pointers\": %zu,\n", records);
+
+        fprintf(file, "  \"types\": [");
+        {
+            std::lock_guard<std::recursive_mutex> guard(stats_mutex);
+            const char * separator = "\n";
+            per_type_table.for_each([&](TYPE_STATS & stats) {
+                MemoryUsage u = stats.memory_usage.load();
+                if (u.current == 0) {
+                    return;
+                }
+                fprintf(file, "%s    {\"name\": ", separator);
+                write_json_string(file, stats.name());
+                fprintf(file, ", \"bytes\": %zu, \"peak\": %zu, \"total\": %zu}", u.current, u.peak, u.total);
+                separator = ",\n";
+            });
+        }
+        fprintf(file, "\n  ],\n");
+
+        fprintf(file, "  \"owners\": [");
+        for (size_t i = 0; i < owner_count; i++) {
+            Owner & o = owners[i];
+            fprintf(file, "%s    {\"allocator\": \"%p\", \"global\": %s, \"objects\": %zu, \"bytes\": %zu, \"shared\": %zu}", i == 0 ? "\n" : ",\n", o.allocator, o.global ? "true" : "false", o.objects, o.bytes, o.shared);
+        }
+        fprintf(file, "\n  ]");
+        inspect_free(owners);
+
+        if (report_sites != nullptr) {
+            fprintf(file, ",\n  \"sites\": [");
+            report_sites(file);
+            fprintf(file, "\n  ]");
+        }
+        fprintf(file, "\n}\n");
+        return fclose(file) == 0;
+    }
+
+#ifdef SA_STACK_ALLOCATOR__LOGGING
+    inline void EVENT_LOG::write_type_names() {
+        auto & singleton = GET_SINGLETONS();
+        std::lock_guard<std::recursive_mutex> guard(singleton.stats_mutex);
+        auto & table = singleton.per_type_table;
+        if (table.capacity > named_capacity) {
+            bool * grown = static_cast<bool*>(calloc(table.capacity, sizeof(bool)));
+            if (grown == nullptr) {
+                return;
+            }
+            if (named != nullptr) {
+                memcpy(grown, named, named_capacity * sizeof(bool));
+                free(named);
+            }
+            named = grown;
+            named_capacity = table.capacity;
+        }
+        for (size_t i = 0; i < table.capacity; i++) {
+            if (table.entries[i].stats == nullptr || named[i]) {
+                continue;
+            }
+            const char * name = table.entries[i].stats->name();
+            size_t length = strlen(name);
+            EVENT e = {};
+            e.timestamp = now();
+            e.op = EVENT::TYPE_NAME;
+            e.size = length;
+            e.type = i;
+            fwrite(&e, sizeof(e), 1, file);
+            fwrite(name, 1, length, file);
+            static const uint8_t zeros[sizeof(EVENT)] = {};
+            size_t padding = (sizeof(EVENT) - length % sizeof(EVENT)) % sizeof(EVENT);
+            fwrite(zeros, 1, padding, file);
+            named[i] = true;
+        }
+    }
+#endif
+
+    class save_cout {
+        std::ostream & s;
+        std::ios_base::fmtflags f;
+
+        public:
+
+        save_cout() : save_cout(std::cout) {}
+        save_cout(std::ostream & o) : s(o), f(o.flags()) {}
+        template <typename T> std::ostream & operator<<(const T & item) { return s << item; }
+        std::ostream & operator*() { return s; }
+        std::ostream * operator->() { return &s; }
+        ~save_cout() { s.setf(f); }
+    };
+
+    // WipePolicy decides how deallocated blocks are wiped, see FastWipe
+    template<typename T, typename WipePolicy>
+    struct Mallocator
+    {
+        typedef T value_type;
+    
+        Mallocator () = default;
+
+        template<class U>
+        constexpr Mallocator (const Mallocator <U, WipePolicy>&) noexcept {};
+
+        template<class U>
+        constexpr Mallocator<T, WipePolicy> & operator= (const Mallocator <U, WipePolicy>&) noexcept {
+            return *this;
+        };
+
+        template<class U>
+        constexpr bool operator== (const Mallocator <U, WipePolicy>&) noexcept { return true; }
+
+        template<class U>
+        constexpr bool operator!= (const Mallocator <U, WipePolicy>&) noexcept { return false; }
+
+        virtual ~Mallocator() {}
+
+        virtual void onAlloc(T * p, size_t n) {}
+        virtual bool onDealloc(T * p, size_t n) { return true; }
+
+        [[nodiscard]] T* allocate(std::size_t n)
+        {
+            return allocate(n, nullptr);
+        }
+
+        // allocates from a specific alloc_hook heap, see TrackedAllocator(bool own_heap)
+        [[nodiscard]] T* allocate(std::size_t n, SINGLETONS::heap_t * heap)
+        {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_array_new_length();
+
+            auto & singleton = GET_SINGLETONS();
+            void * ptr;
+            while (true) {
+                // calloc initializes memory and stops valgrind complaining about uninitialized memory use
+                ptr = SINGLETONS::inspect_heap_calloc(heap, n, sizeof(T));
+                if (ptr == nullptr) {
+                    auto handler = std::get_new_handler();
+                    if (handler == nullptr) {
+                        throw std::bad_alloc();
+                    } else {
+                        handler();
+                        continue;
+                    }
+                } else {
+                    break;
+                }
+            }
+            singleton.account_alloc<T>(sizeof(T)*n);
+            onAlloc(static_cast<T*>(ptr), sizeof(T)*n);
+            return static_cast<T*>(ptr);
+        }
+    
+        void secure_free(T* p, std::size_t n) noexcept
+        {
+            if constexpr (WipePolicy::wipes) {
+                WipePolicy::zero(p, sizeof(T)*n);
+            }
+            SINGLETONS::inspect_free(p);
+            GET_SINGLETONS().account_free<T>(sizeof(T)*n);
+        }
+
+        void deallocate(T* p, std::size_t n) noexcept
+        {
+            if (p == nullptr) {
+                return;
+            }
+            if (onDealloc(p, sizeof(T)*n)) {
+                secure_free(p, n);
+            } else {
+                Logeb();
+                printf("error: pointer %p could not be found in the list of allocated pointers, ignoring\n", p);
+                Logr();
+            }
+        }
+    };
+
+    template<typename T, typename WipePolicy = FastWipe>
+    struct TrackedMallocator : public Mallocator<T, WipePolicy>
+    {
+        using Mallocator<T, WipePolicy>::Mallocator;
+
+        void onAlloc(T * p, std::size_t n) override {
+            GET_SINGLETONS().pointers.add_pointer(p);
+        }
+    
+        bool onDealloc(T * p, std::size_t n) override {
+            return GET_SINGLETONS().pointers.remove_pointer(p);
+        }
+    };
+
+    template <typename T, typename WipePolicy = FastWipe>
+    static TrackedMallocator<T, WipePolicy> & GET_TRACKED_MALLOCATOR() {
+        static TrackedMallocator<T, WipePolicy> m;
+        return m;
+    }
+
+    // BasicAllocator policies, allocators with different policies may free and adopt each other's pointers since every
+    // block records how it is destroyed
+
+    // LockPolicy guards the allocator's own list of allocations, the shared registries are always locked
+    struct MutexLock {
+        std::mutex mutex;
+        void lock() { mutex.lock(); }
+        void unlock() { mutex.unlock(); }
+    };
+
+    // the allocator and everything it allocates must only be used from one thread at a time, dealloc included
+    struct NoLock {
+        void lock() {}
+        void unlock() {}
+    };
+
+    // StatsPolicy, TypeStats accounts to the global and per type statistics and calls the virtual onAlloc hook
+    struct TypeStats {
+        static constexpr bool enabled = true;
+    };
+
+    struct NoStats {
+        static constexpr bool enabled = false;
+    };
+
+    // BackingPolicy, MagazineBacking serves small blocks from the per thread magazines, CallocBacking always calls calloc
+    // (alloc_hook_calloc with SA_STACK_ALLOCATOR_ALLOC_HOOK)
+    struct MagazineBacking {
+        static constexpr bool magazines = true;
+    };
+
+    struct CallocBacking {
+        static constexpr bool magazines = false;
+    };
+
+    // WipePolicy is one of NoWipe, FastWipe and ParanoidWipe defined at the top
+
+    // the base of allocators that keep statistics
+    struct AllocatorHooks : AllocatorBase {
+        virtual ~AllocatorHooks() {}
+
+        protected:
+
+        virtual void onAlloc(void * p, std::size_t n) {}
+        virtual void onDealloc(void * p, std::size_t n) {}
+        // what onAlloc and onDealloc keep count in, handed over by BasicAllocator::splice, nullptr if nothing is kept
+        virtual SINGLETONS::USAGE_COUNTER * usageCounter() { return nullptr; }
+    };
+
+    // the tracking record of a BasicAllocator::alloc allocation
+    //
+    // the header sits right before the object, the cookie is the last member so it is the word right before the
+    // pointer, it is never read when the pointer is page aligned as the page before may not be mapped for a foreign
+    // pointer, allocations never hand out such a pointer
+    struct alignas(std::max_align_t) ALLOCATION_HEADER {
+        ALLOCATION_HEADER * prev;
+        ALLOCATION_HEADER * next;
+        // nullptr once unlinked
+        OWNER_HANDLE * owner;
+        // takes the header out of the owner's list, whatever its policies
+        bool (*unlink)(OWNER_HANDLE * owner, ALLOCATION_HEADER * header);
+        // runs the element destructors and frees the block
+        void (*destroy)(ALLOCATION_HEADER * header);
+        size_t count;
+        // bytes between the start of the block and the header
+        uint8_t pad;
+        // the block came from a magazine
+        bool cached;
+        // the pointer was adopted by another allocator, its registry record now decides when it is freed
+        bool shared;
+        // false for the operator new override allocations, they are owned but never enter the list
+        bool listed;
+        // sizeof the element type, size * count is what the block was accounted with
+        uint32_t size;
+        size_t cookie;
+    };
+
+    static_assert(sizeof(ALLOCATION_HEADER) == 64, "keep the header one cache line");
+
+    // what a BasicAllocator does with the objects it still owns when it is destroyed
+    //
+    // Inline runs every destructor and free before the destructor returns, Background hands them to the reclamation
+    // thread and Incremental leaves them queued until GET_RECLAIMER().reclaim(budget) runs them, either way the objects
+    // must not be used once the scope ended and their destructors must not use the allocator they belonged to
+    enum class Teardown {
+        Inline,
+        Background,
+        Incremental
+    };
+
+    struct ReclaimStats {
+        // batches and objects still waiting to be destroyed
+        size_t queued_batches;
+        size_t queued_objects;
+        size_t reclaimed_batches;
+        size_t reclaimed_objects;
+        // how long the oldest queued batch has been waiting
+        std::chrono::nanoseconds oldest;
+        // time between handing a batch over and its last object being destroyed
+        std::chrono::nanoseconds last_lag;
+        std::chrono::nanoseconds max_lag;
+    };
+
+    // destroys the objects of allocators that deferred their teardown
+    //
+    // a batch is the header list of one allocator taken as a whole plus the registry records it held the last
+    // reference to, already unlinked from the registry so nothing else can reach them, its shared headers are still
+    // referenced under the handle each of them names, the batch frees the owner handle of the allocator and the handles
+    // spliced into it once it is done
+    struct RECLAIMER {
+
+        struct Batch {
+            Batch * next = nullptr;
+            OWNER_HANDLE * owner = nullptr;
+            ALLOCATION_HEADER * headers = nullptr;
+            SINGLETONS::PointerInfo ** records = nullptr;
+            size_t record_count = 0;
+            size_t objects = 0;
+            std::chrono::steady_clock::time_point queued;
+            bool background = false;
+            // taken by a thread running it
+            bool busy = false;
+        };
+
+        SA____STACK_ALLOCATOR__REF_ONLY(RECLAIMER, RECLAIMER);
+
+        // takes ownership of owner and of records, an inspect_calloc'd array
+        void defer(OWNER_HANDLE * owner, ALLOCATION_HEADER * headers, size_t header_count, SINGLETONS::PointerInfo ** records, size_t record_count, bool background) {
+            Batch * b = SINGLETONS::alloc<Batch>();
+            b->owner = owner;
+            b->headers = headers;
+            b->records = records;
+            b->record_count = record_count;
+            b->objects = header_count + record_count;
+            b->queued = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                // a scope torn down by a destructor we run at exit is left to that final reclaim
+                background = background && !stopping;
+                b->background = background;
+                if (tail != nullptr) {
+                    tail->next = b;
+                } else {
+                    head = b;
+                }
+                tail = b;
+                queued_batches++;
+                queued_objects += b->objects;
+                if (background && !drainer.joinable()) {
+                    drainer = std::thread([this]() { run(); });
+                }
+            }
+            if (background) {
+                wake.notify_one();
+            }
+        }
+
+        // destroys queued objects on the calling thread until budget runs out, returns how many were destroyed
+        size_t reclaim(std::chrono::nanoseconds budget = std::chrono::nanoseconds::max()) {
+            auto deadline = budget == std::chrono::nanoseconds::max() ? std::chrono::steady_clock::time_point::max() : std::chrono::steady_clock::now() + budget;
+            size_t destroyed = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (Batch * b = take(false)) {
+                lock.unlock();
+                size_t before = b->objects;
+                bool done = run(*b, deadline);
+                destroyed += before - b->objects;
+                lock.lock();
+                put_back(b, done, before - b->objects);
+                if (!done) {
+                    break;
+                }
+            }
+            return destroyed;
+        }
+
+        ReclaimStats stats() {
+            std::lock_guard<std::mutex> guard(mutex);
+            ReclaimStats s;
+            s.queued_batches = queued_batches;
+            s.queued_objects = queued_objects;
+            s.reclaimed_batches = reclaimed_batches;
+            s.reclaimed_objects = reclaimed_objects;
+            s.oldest = head == nullptr ? std::chrono::nanoseconds(0) : std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - head->queued);
+            s.last_lag = last_lag;
+            s.max_lag = max_lag;
+            return s;
+        }
+
+        ~RECLAIMER() {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            if (drainer.joinable()) {
+                drainer.join();
+            }
+            // whatever is left is destroyed before the registry and the magazines go away
+            reclaim();
+            if (log) {
+                Logeb();
+                printf("~RECLAIMER()\n");
+                Logr();
+            }
+        }
+
+        private:
+
+        // the first idle batch, only background ones for the reclamation thread, the caller holds mutex
+        Batch * take(bool background_only) {
+            for (Batch * b = head; b != nullptr; b = b->next) {
+                if (!b->busy && (b->background || !background_only)) {
+                    b->busy = true;
+                    return b;
+                }
+            }
+            return nullptr;
+        }
+
+        // the caller holds mutex
+        void put_back(Batch * b, bool finished, size_t destroyed) {
+            queued_objects -= destroyed;
+            reclaimed_objects += destroyed;
+            b->busy = false;
+            if (finished) {
+                Batch * prev = nullptr;
+                for (Batch * it = head; it != b; it = it->next) {
+                    prev = it;
+                }
+                if (prev != nullptr) {
+                    prev->next = b->next;
+                } else {
+                    head = b->next;
+                }
+                if (tail == b) {
+                    tail = prev;
+                }
+                queued_batches--;
+                reclaimed_batches++;
+                last_lag = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - b->queued);
+                max_lag = std::max(max_lag, last_lag);
+                SINGLETONS::inspect_free(b->records);
+                OWNER_HANDLE::release(b->owner);
+                SINGLETONS::dealloc(&b);
+            }
+        }
+
+        // one object at a time in the order dealloc_all would, the clock is read every 64 objects, returns true once
+        // the batch is empty
+        static bool run(Batch & b, std::chrono::steady_clock::time_point deadline) {
+            auto & tracked = GET_SINGLETONS().tracked_pointers;
+            size_t n = 0;
+            while (b.headers != nullptr) {
+                ALLOCATION_HEADER * h = b.headers;
+                b.headers = h->next;
+                if (b.headers != nullptr) {
+                    b.headers->prev = nullptr;
+                }
+                h->next = nullptr;
+                // the allocator's own handle or one spliced into it, the one the pointer was shared under
+                OWNER_HANDLE * owner = h->owner;
+                h->owner = nullptr;
+                if (h->shared) {
+                    tracked.unref(h + 1, owner, false);
+                } else {
+                    h->destroy(h);
+                }
+                b.objects--;
+                if ((++n & 63) == 0 && std::chrono::steady_clock::now() >= deadline) {
+                    return b.headers == nullptr && b.record_count == 0;
+                }
+            }
+            while (b.record_count != 0) {
+                SINGLETONS::dealloc(&b.records[--b.record_count]);
+                b.objects--;
+                if ((++n & 63) == 0 && std::chrono::steady_clock::now() >= deadline) {
+                    return b.record_count == 0;
+                }
+            }
+            return true;
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                Batch * b = nullptr;
+                wake.wait(lock, [&]() { return stopping || (b = take(true)) != nullptr; });
+                if (b == nullptr) {
+                    return;
+                }
+                lock.unlock();
+                size_t before = b->objects;
+                run(*b, std::chrono::steady_clock::time_point::max());
+                lock.lock();
+                put_back(b, true, before);
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        Batch * head = nullptr;
+        Batch * tail = nullptr;
+        bool stopping = false;
+        std::thread drainer;
+        size_t queued_batches = 0;
+        size_t queued_objects = 0;
+        size_t reclaimed_batches = 0;
+        size_t reclaimed_objects = 0;
+        std::chrono::nanoseconds last_lag {0};
+        std::chrono::nanoseconds max_lag {0};
+    };
+
+    template <typename LockPolicy, typename StatsPolicy, typename BackingPolicy, typename WipePolicy>
+    struct BasicAllocator : std::conditional_t<StatsPolicy::enabled, AllocatorHooks, AllocatorBase> {
+
+        BasicAllocator() {}
+
+        // when own_heap is true and alloc_hook is enabled, allocations come from a private alloc_hook heap instead of
+        // the shared one, the heap is thread local so such an allocator must only allocate from and be destroyed on the
+        // thread that created it, deallocating from any thread is fine
+        //
+        // without alloc_hook this is the same as the default constructor
+        explicit BasicAllocator(bool own_heap) {
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            if (own_heap) {
+                heap = alloc_hook_heap_new();
+                if (heap == nullptr) {
+                    throw std::bad_alloc();
+                }
+            }
+#endif
+        }
+
+        BasicAllocator(const BasicAllocator & other) = delete;
+        BasicAllocator & operator=(const BasicAllocator & other) = delete;
+
+        // O(1), the owner handle of other follows its allocations here and other keeps the fresh handle we were made
+        // with, nothing other owns is visited
+        BasicAllocator(BasicAllocator && other) : heap(other.heap), teardown(other.teardown) {
+            other.heap = nullptr;
+            swap_owner(other);
+        }
+
+        // O(1) as well, if we already own something that is kept and other is spliced into us
+        BasicAllocator & operator=(BasicAllocator && other) {
+            if (this != &other) {
+                bool empty;
+                {
+                    std::lock_guard<LockPolicy> guard(headers_mutex);
+                    empty = heap == nullptr && headers == nullptr && owned.size == 0 && !handle->pinned.load(std::memory_order_relaxed);
+                }
+                teardown = other.teardown;
+                if (empty) {
+                    heap = other.heap;
+                    other.heap = nullptr;
+                    swap_owner(other);
+                } else {
+                    splice(other);
+                }
+            }
+            return *this;
+        }
+
+        // takes over everything other owns, other is left empty and can be used again
+        //
+        // other's handle is forwarded to ours so every header allocation naming it is ours where it is, without being
+        // visited, and its header list is put in front of ours, which dealloc_all destroys first, only the registry
+        // records other references (adopted pointers, over aligned types, the blocks of an owned heap) are rebound, one
+        // shard lock at a time, other's handle is freed right away when no header names it, else with the last of them
+        //
+        // nothing else may use other while it is spliced, an allocator that owns a heap must be spliced on its own thread
+        void splice(BasicAllocator & other) {
+            if (&other == this) {
+                return;
+            }
+            OWNER_HANDLE * fresh = new_handle(&other);
+            OWNER_HANDLE * spliced = other.handle;
+            size_t bytes = 0;
+            void ** ptrs;
+            size_t count = other.take_owned_pointers(&ptrs);
+            bytes += rebind(ptrs, count, spliced);
+            SINGLETONS::inspect_free(ptrs);
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            if (other.heap != nullptr) {
+                // its blocks are listed nowhere, deleting the heap moves them to the default heap
+                HeapBlocks b;
+                alloc_hook_heap_visit_blocks(other.heap, true, collect_heap_block, &b);
+                if (b.failed) {
+                    SINGLETONS::inspect_free(b.blocks);
+                    SINGLETONS::dealloc(&fresh);
+                    throw std::bad_alloc();
+                }
+                bytes += rebind(b.blocks, b.count, spliced);
+                SINGLETONS::inspect_free(b.blocks);
+                alloc_hook_heap_delete(other.heap);
+                other.heap = alloc_hook_heap_new();
+                if (other.heap == nullptr) {
+                    SINGLETONS::dealloc(&fresh);
+                    throw std::bad_alloc();
+                }
+            }
+#endif
+            // nothing references the spliced handle under the owned set anymore, its listed allocations are about to be ours
+            other.leave_directory();
+            GET_SINGLETONS().live_allocators.remove(spliced);
+            OWNER_HANDLE * retired = nullptr;
+            SINGLETONS::USAGE_COUNTER * to = nullptr;
+            SINGLETONS::USAGE_COUNTER * from = nullptr;
+            if constexpr (StatsPolicy::enabled) {
+                to = this->usageCounter();
+                from = other.usageCounter();
+            }
+            {
+                bool ordered = std::less<BasicAllocator*>()(this, &other);
+                std::lock_guard<LockPolicy> first(ordered ? headers_mutex : other.headers_mutex);
+                std::lock_guard<LockPolicy> second(ordered ? other.headers_mutex : headers_mutex);
+                if (to != nullptr && from == nullptr) {
+                    // other kept no count of what it allocated
+                    for (Header * h = other.headers; h != nullptr; h = h->next) {
+                        bytes += static_cast<size_t>(h->size)*h->count;
+                    }
+                }
+                spliced->allocator = nullptr;
+                if (spliced->listed == 0 && spliced->absorbed == nullptr && !spliced->pinned.load(std::memory_order_relaxed)) {
+                    // nothing names it anymore
+                    retired = spliced;
+                } else {
+                    spliced->forward = handle;
+                    spliced->sibling = handle->absorbed;
+                    if (handle->absorbed != nullptr) {
+                        handle->absorbed->prev_sibling = spliced;
+                    }
+                    handle->absorbed = spliced;
+                }
+                other.handle = fresh;
+                // its node cache is now one of our objects, its adapters start a new one
+                other.std_cache.store(nullptr, std::memory_order_release);
+                if (other.headers != nullptr) {
+                    other.headers_tail->next = headers;
+                    if (headers != nullptr) {
+                        headers->prev = other.headers_tail;
+                    } else {
+                        headers_tail = other.headers_tail;
+                    }
+                    headers = other.headers;
+                    header_count += other.header_count;
+                    other.headers = nullptr;
+                    other.headers_tail = nullptr;
+                    other.header_count = 0;
+                }
+            }
+            OWNER_HANDLE::release(retired);
+            if (to != nullptr && from != nullptr) {
+                to->merge(*from);
+            } else if (to != nullptr) {
+                to->add(bytes);
+            } else if (from != nullptr) {
+                from->sub(from->load().current);
+            }
+        }
+
+        // stable for the lifetime of the allocator, across moves
+        OWNER_HANDLE * owner_handle() const {
+            return handle;
+        }
+
+        // the node cache of every ScopedStdAllocator bound to us, created on first use, it is one of our objects so it
+        // goes with dealloc_all and follows a move or a splice
+        STD_NODE_CACHE<LockPolicy> * std_node_cache() {
+            STD_NODE_CACHE<LockPolicy> * cache = std_cache.load(std::memory_order_acquire);
+            if (cache == nullptr) {
+                // two threads may race to create it, the loser frees its own
+                STD_NODE_CACHE<LockPolicy> * fresh = alloc<STD_NODE_CACHE<LockPolicy>>();
+                if (std_cache.compare_exchange_strong(cache, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    cache = fresh;
+                } else {
+                    dealloc(fresh);
+                }
+            }
+            return cache;
+        }
+        
+        template <typename T>
+        void adopt(T * ptr) {
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ADOPT, ptr, 0, SINGLETONS::TYPE_TABLE::index_of<T>(), handle);
+            if (adopt_header(ptr)) {
+                return;
+            }
+            adopt_internal(ptr, element_size<T>(), &delete_object<T>, nullptr, nullptr);
+        }
+
+        // captureless deleters are stored as a plain function pointer, anything else is moved into a small bound object
+        template <typename T, typename D>
+        void adopt(T * ptr, D destructor) {
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ADOPT, ptr, 0, SINGLETONS::TYPE_TABLE::index_of<T>(), handle);
+            if (adopt_header(ptr)) {
+                // allocated by a BasicAllocator, it keeps the destructor it was allocated with
+                return;
+            }
+            if constexpr (std::is_convertible<D, void(*)(void*)>::value) {
+                adopt_internal(ptr, element_size<T>(), static_cast<void(*)(void*)>(destructor), nullptr, nullptr);
+            } else {
+                // built before taking the shard lock, nothing under it may call operator new
+                D * bound = SINGLETONS::alloc<D>(std::move(destructor));
+                if (!adopt_internal(ptr, element_size<T>(), nullptr, &destroy_bound<D>, bound)) {
+                    SINGLETONS::dealloc(&bound);
+                } else {
+                    GET_SINGLETONS().metadata_usage.fetch_add(sizeof(D), std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // a pointer obtained from alloc is not freed by anyone after being released until it is adopted again, it must
+        // never be passed to free or delete
+        static void release(void * ptr) {
+            Header * h = header_of(ptr);
+            if (h != nullptr && !h->shared) {
+                SA____STACK_ALLOCATOR__EVENT(EVENT::RELEASE, ptr);
+                OWNER_HANDLE * owner = h->owner;
+                // dont release if owned by global
+                if (owner != nullptr && !owner->resolve()->global) {
+                    h->unlink(owner, h);
+                }
+                return;
+            }
+            GET_SINGLETONS().tracked_pointers.release(ptr);
+        }
+
+        template <typename T, typename ... Args>
+        [[nodiscard]] T* alloc(Args && ... args) {
+            T * ptr = alloc_internal<T>(1);
+            new (ptr) T(std::forward<Args>(args)...);
+            return ptr;
+        }
+
+        template <typename T>
+        [[nodiscard]] T* allocArray(size_t count) {
+            T * ptr = alloc_internal<T>(count);
+            for (size_t i = 0; i < count; i++) {
+                new (ptr + i) T();
+            }
+            return ptr;
+        }
+
+        [[nodiscard]] void * alloc(std::size_t s) {
+            return alloc_internal<uint8_t>(s);
+        }
+
+        // the operator new override path, the allocation is owned by this allocator but never listed so neither it nor
+        // dealloc takes a lock, dealloc_all does not free it, the memory is not zeroed, it is not wiped either and it is
+        // accounted in batches whatever the StatsPolicy, see SINGLETONS::UNLISTED_BATCH
+        //
+        // use_cache = false skips the magazines, for requests that arrive while this thread is already allocating
+        [[nodiscard]] void * alloc_unlisted(std::size_t s, bool use_cache = true) {
+#if SA_STACK_ALLOCATOR__HEADER_LAYOUT
+            if (heap == nullptr) {
+                return alloc_with_header<uint8_t>(s, false, use_cache);
+            }
+#endif
+            return alloc_internal<uint8_t>(s);
+        }
+
+        // on_free(ptr, size) runs right before an alloc_unlisted block is destroyed, however it is freed, the heap
+        // profiler uses it to see its samples go away, returns false if ptr does not carry a header
+        template <void (*on_free)(void * ptr, size_t size)>
+        static bool watch_free(void * ptr) {
+            Header * h = header_of(ptr);
+            if (h == nullptr) {
+                return false;
+            }
+            h->destroy = &destroy_watched<on_free>;
+            return true;
+        }
+
+        void dealloc(void* ptr) {
+            if (ptr == nullptr) {
+                return;
+            }
+            SA____STACK_ALLOCATOR__EVENT(EVENT::DEALLOC, ptr, 0, EVENT::no_type, handle);
+            // our own allocations are found through their header without touching the registry
+            Header * h = header_of(ptr);
+            OWNER_HANDLE * retired = nullptr;
+            OWNER_HANDLE * owner = h != nullptr ? unlink(h, retired) : nullptr;
+            if (owner != nullptr) {
+                finish_header(h, owner, retired);
+                return;
+            }
+            internal_dealloc(ptr);
+        }
+
+        // the batched forms take each lock once for the whole batch instead of once per pointer, nullptr entries are
+        // skipped, the result is the same as calling adopt, release or dealloc on every pointer in turn
+
+        template <typename T>
+        void adopt_many(T * const * ptrs, size_t count) {
+            adopt_many_internal<T, void>(ptrs, count, &delete_object<T>, nullptr);
+        }
+
+        // a stateful deleter is copied into a bound object for every pointer of the batch
+        template <typename T, typename D>
+        void adopt_many(T * const * ptrs, size_t count, D destructor) {
+            if constexpr (std::is_convertible<D, void(*)(void*)>::value) {
+                adopt_many_internal<T, void>(ptrs, count, static_cast<void(*)(void*)>(destructor), nullptr);
+            } else {
+                adopt_many_internal<T, D>(ptrs, count, nullptr, &destructor);
+            }
+        }
+
+        template <typename T>
+        static void release_many(T * const * ptrs, size_t count) {
+            void ** rest = nullptr;
+            size_t remaining = 0;
+            for (size_t i = 0; i < count; i++) {
+                void * ptr = const_cast<void*>(static_cast<const void*>(ptrs[i]));
+                Header * h = header_of(ptr);
+                if (h != nullptr && !h->shared) {
+                    release(ptr);
+                    continue;
+                }
+                if (rest == nullptr) {
+                    rest = static_cast<void**>(SINGLETONS::inspect_calloc(count, sizeof(void*)));
+                    if (rest == nullptr) throw std::bad_alloc();
+                }
+                rest[remaining++] = ptr;
+            }
+            GET_SINGLETONS().tracked_pointers.release_many(rest, remaining);
+            SINGLETONS::inspect_free(rest);
+        }
+
+        // our own allocations are unlinked under a single list lock and destroyed after it is dropped, everything
+        // else is dropped from the registry one shard at a time
+        template <typename T>
+        void dealloc_many(T * const * ptrs, size_t count) {
+            if (count == 0) {
+                return;
+            }
+            // unlinked headers fill the scratch array from the front, registry pointers from the back, the handles the
+            // headers named follow, then the handles their unlinking retired
+            void ** scratch = static_cast<void**>(SINGLETONS::inspect_calloc(count * 3, sizeof(void*)));
+            if (scratch == nullptr) {
+                throw std::bad_alloc();
+            }
+            OWNER_HANDLE ** owners = reinterpret_cast<OWNER_HANDLE**>(scratch + count);
+            OWNER_HANDLE ** retired = owners + count;
+            size_t unlinked = 0;
+            size_t rest = count;
+            {
+                std::lock_guard<LockPolicy> guard(headers_mutex);
+                for (size_t i = 0; i < count; i++) {
+                    void * ptr = const_cast<void*>(static_cast<const void*>(ptrs[i]));
+                    if (ptr == nullptr) {
+                        continue;
+                    }
+                    SA____STACK_ALLOCATOR__EVENT(EVENT::DEALLOC, ptr, 0, EVENT::no_type, handle);
+                    Header * h = header_of(ptr);
+                    OWNER_HANDLE * owner = h != nullptr ? unlink_locked(h, retired[unlinked]) : nullptr;
+                    if (owner != nullptr) {
+                        owners[unlinked] = owner;
+                        scratch[unlinked++] = h;
+                    } else {
+                        scratch[--rest] = ptr;
+                        owned.remove(ptr);
+                    }
+                }
+            }
+            for (size_t i = 0; i < unlinked; i++) {
+                on_unlinked(static_cast<Header*>(scratch[i]));
+                finish_header(static_cast<Header*>(scratch[i]), owners[i], retired[i]);
+            }
+            GET_SINGLETONS().tracked_pointers.unref_many(scratch + rest, count - rest, handle);
+            SINGLETONS::inspect_free(scratch);
+        }
+
+        void dealloc_all() {
+            dealloc_all(true);
+        }
+
+        // Teardown::Inline by default, an allocator that owns a heap always tears down inline since its heap can only
+        // be destroyed on its own thread
+        void set_teardown(Teardown mode) {
+            teardown = mode;
+        }
+
+        ~BasicAllocator() {
+            bool deferred = false;
+            if (tears_down_inline()) {
+                dealloc_all(false);
+            } else {
+                deferred = defer_teardown();
+            }
+            release_heap();
+            leave_directory();
+            GET_SINGLETONS().live_allocators.remove(handle);
+            handle->allocator = nullptr;
+            if (!deferred) {
+                OWNER_HANDLE::release(handle);
+            }
+        }
+
+        protected:
+
+        // false if the destructor hands what we own to the reclaimer, see set_teardown
+        bool tears_down_inline() const {
+            return teardown == Teardown::Inline || heap != nullptr;
+        }
+
+        private:
+
+        SINGLETONS::heap_t * heap = nullptr;
+
+        // see std_node_cache
+        std::atomic<STD_NODE_CACHE<LockPolicy>*> std_cache{nullptr};
+
+        // what everything we own is owned under, the registry records reference it, so do the headers and the owner
+        // directory, see swap_owner
+        OWNER_HANDLE * handle = new_handle(this);
+
+        static OWNER_HANDLE * new_handle(BasicAllocator * allocator) {
+            OWNER_HANDLE * h = SINGLETONS::alloc<OWNER_HANDLE>();
+            h->allocator = allocator;
+            return h;
+        }
+
+        static BasicAllocator * allocator_of(void * owner) {
+            return static_cast<BasicAllocator*>(static_cast<OWNER_HANDLE*>(owner)->resolve()->allocator);
+        }
+
+        // our handle or one spliced into it
+        bool is_ours(OWNER_HANDLE * owner) {
+            return owner == handle || (owner != nullptr && owner->resolve() == handle);
+        }
+
+        using Header = ALLOCATION_HEADER;
+
+        static constexpr size_t header_page_size = 4096;
+        // non cached blocks reserve this much so the pointer can always be moved off a page boundary
+        static constexpr size_t header_slack = alignof(Header);
+
+        // intrusive list of the live allocations that carry a header, newest first, the tail lets splice put a whole
+        // list in front of another
+        Header * headers = nullptr;
+        Header * headers_tail = nullptr;
+        size_t header_count = 0;
+        // guards headers and owned
+        LockPolicy headers_mutex;
+
+        // the registry records we reference that neither the header list nor the owned heap can find, such as adopted
+        // pointers, so dealloc_all only visits our own records
+        //
+        // release() takes pointers out through the owner directory, which we join the first time we own something
+        SINGLETONS::SA__PointerMap<bool> owned;
+        std::atomic<bool> in_directory {false};
+
+        static size_t header_cookie(void * ptr) {
+            return reinterpret_cast<uintptr_t>(ptr) ^ static_cast<size_t>(0x5A3C96E1D2B4870FULL);
+        }
+
+        SA____STACK_ALLOCATOR__NO_SANITIZE_ADDRESS
+        static Header * header_of(void * ptr) {
+#if SA_STACK_ALLOCATOR__HEADER_LAYOUT
+            uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+            if (p == 0 || (p & (header_page_size - 1)) == 0 || (p & (alignof(Header) - 1)) != 0) {
+                return nullptr;
+            }
+            Header * h = static_cast<Header*>(ptr) - 1;
+            return h->cookie == header_cookie(ptr) ? h : nullptr;
+#else
+            return nullptr;
+#endif
+        }
+
+        static bool unlink_from(OWNER_HANDLE * owner, Header * h) {
+            BasicAllocator * allocator = allocator_of(owner);
+            if (allocator == nullptr) {
+                // an unlisted block of an allocator that is gone, see OWNER_HANDLE::pinned
+                h->owner = nullptr;
+                return true;
+            }
+            OWNER_HANDLE * retired = nullptr;
+            bool unlinked = allocator->unlink(h, retired) != nullptr;
+            OWNER_HANDLE::release(retired);
+            return unlinked;
+        }
+
+        void link(Header * h) {
+            if (!handle->live.load(std::memory_order_relaxed)) {
+                GET_SINGLETONS().live_allocators.add(handle, &count_listed);
+            }
+            std::lock_guard<LockPolicy> guard(headers_mutex);
+            h->owner = handle;
+            h->unlink = &unlink_from;
+            h->listed = true;
+            h->prev = nullptr;
+            h->next = headers;
+            if (headers != nullptr) {
+                headers->prev = h;
+            } else {
+                headers_tail = h;
+            }
+            headers = h;
+            header_count++;
+            handle->listed++;
+        }
+
+        // returns the handle h named, nullptr if h is not linked to this allocator, see unlink_locked for retired
+        OWNER_HANDLE * unlink(Header * h, OWNER_HANDLE *& retired) {
+            OWNER_HANDLE * owner;
+            if (!h->listed) {
+                // nothing to take out, so no lock either
+                owner = unlink_locked(h, retired);
+            } else {
+                std::lock_guard<LockPolicy> guard(headers_mutex);
+                owner = unlink_locked(h, retired);
+            }
+            if (owner != nullptr) {
+                on_unlinked(h);
+            }
+            return owner;
+        }
+
+        // a header allocation stopped being ours, whether it is freed or released, called with no lock held
+        void on_unlinked(Header * h) {
+            if constexpr (StatsPolicy::enabled) {
+                this->onDealloc(h + 1, static_cast<size_t>(h->size)*h->count);
+            }
+        }
+
+        // the caller holds headers_mutex unless h is unlisted, retired is set to the spliced handles h was the last
+        // header of, see retire_locked
+        OWNER_HANDLE * unlink_locked(Header * h, OWNER_HANDLE *& retired) {
+            OWNER_HANDLE * owner = h->owner;
+            if (!is_ours(owner)) {
+                return nullptr;
+            }
+            if (!h->listed) {
+                h->owner = nullptr;
+                return owner;
+            }
+            if (h->prev != nullptr) {
+                h->prev->next = h->next;
+            } else {
+                headers = h->next;
+            }
+            if (h->next != nullptr) {
+                h->next->prev = h->prev;
+            } else {
+                headers_tail = h->prev;
+            }
+            h->prev = nullptr;
+            h->next = nullptr;
+            h->owner = nullptr;
+            header_count--;
+            owner->listed--;
+            retired = retire_locked(owner);
+            return owner;
+        }
+
+        // a spliced handle no listed header names anymore and nothing was spliced into is taken out of the handles
+        // spliced into ours, and so is every handle it was spliced through that is left empty, returns them linked
+        // through sibling, the caller frees them with OWNER_HANDLE::release once it no longer uses h as a registry owner
+        //
+        // the caller holds headers_mutex
+        OWNER_HANDLE * retire_locked(OWNER_HANDLE * h) {
+            OWNER_HANDLE * retired = nullptr;
+            while (h != handle && h->listed == 0 && h->absorbed == nullptr && !h->pinned.load(std::memory_order_relaxed)) {
+                OWNER_HANDLE * parent = h->forward;
+                if (h->prev_sibling != nullptr) {
+                    h->prev_sibling->sibling = h->sibling;
+                } else {
+                    parent->absorbed = h->sibling;
+                }
+                if (h->sibling != nullptr) {
+                    h->sibling->prev_sibling = h->prev_sibling;
+                }
+                h->forward = nullptr;
+                h->prev_sibling = nullptr;
+                h->sibling = retired;
+                retired = h;
+                h = parent;
+            }
+            return retired;
+        }
+
+        // owner is set to the handle the header named, retired as for unlink_locked
+        Header * pop_header(OWNER_HANDLE *& owner, OWNER_HANDLE *& retired) {
+            std::lock_guard<LockPolicy> guard(headers_mutex);
+            Header * h = headers;
+            retired = nullptr;
+            if (h != nullptr) {
+                headers = h->next;
+                if (headers != nullptr) {
+                    headers->prev = nullptr;
+                } else {
+                    headers_tail = nullptr;
+                }
+                h->next = nullptr;
+                owner = h->owner;
+                h->owner = nullptr;
+                header_count--;
+                owner->listed--;
+                retired = retire_locked(owner);
+            }
+            return h;
+        }
+
+        // exchanges what we are known by with other, our allocations become other's and the other way around, the
+        // headers keep their owner handle so both lists are handed over as a whole
+        //
+        // the caller makes sure nothing else uses this allocator, other may still be released from
+        void swap_owner(BasicAllocator & other) {
+            std::lock_guard<LockPolicy> guard(other.headers_mutex);
+            std::swap(handle, other.handle);
+            handle->allocator = this;
+            other.handle->allocator = &other;
+            std::swap(headers, other.headers);
+            std::swap(headers_tail, other.headers_tail);
+            std::swap(header_count, other.header_count);
+            std_cache.store(other.std_cache.exchange(std_cache.load(std::memory_order_relaxed), std::memory_order_acq_rel), std::memory_order_release);
+            owned.swap(other.owned);
+            bool joined = in_directory.load(std::memory_order_relaxed);
+            in_directory.store(other.in_directory.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.in_directory.store(joined, std::memory_order_relaxed);
+        }
+
+        // h is already unlinked, a shared header is referenced under the handle it named, see splice, one spliced in
+        // from an allocator that had shared it with us is referenced under our handle as well, both go
+        void finish_header(Header * h, OWNER_HANDLE * owner, OWNER_HANDLE * retired) {
+            if (h->shared) {
+                auto & tracked = GET_SINGLETONS().tracked_pointers;
+                bool both = owner != handle && disown(h + 1);
+                tracked.unref(h + 1, owner, false);
+                if (both) {
+                    tracked.unref(h + 1, handle, false);
+                }
+            } else {
+                h->destroy(h);
+            }
+            OWNER_HANDLE::release(retired);
+        }
+
+        // see OWNER_HANDLE::count_listed, a shared allocation is counted from its registry record instead
+        static void count_listed(OWNER_HANDLE * owner, size_t & objects, size_t & bytes) {
+            BasicAllocator * allocator = static_cast<BasicAllocator*>(owner->allocator);
+            std::lock_guard<LockPolicy> guard(allocator->headers_mutex);
+            for (Header * h = allocator->headers; h != nullptr; h = h->next) {
+                if (!h->shared) {
+                    objects++;
+                    bytes += static_cast<size_t>(h->size)*h->count;
+                }
+            }
+        }
+
+        // the registry record of a shared header pointer, it frees the block once every owner let go
+        static void destroy_header_record(SINGLETONS::PointerInfo & p) {
+            if (p.pointer != nullptr) {
+                Header * h = static_cast<Header*>(p.context);
+                // the allocating allocator may still list it if the pointer was released and then adopted again
+                OWNER_HANDLE * owner = h->owner;
+                if (owner != nullptr) {
+                    h->unlink(owner, h);
+                }
+                h->destroy(h);
+            }
+        }
+
+        // returns true if ptr was allocated by any BasicAllocator, it is then owned by this allocator as well
+        bool adopt_header(void * ptr) {
+            Header * h = header_of(ptr);
+            if (h == nullptr) {
+                return false;
+            }
+            OWNER_HANDLE * owner = h->owner;
+            if (is_ours(owner)) {
+                return true;
+            }
+            join_directory();
+            // the allocating allocator becomes a registry owner too the first time the pointer is shared
+            GET_SINGLETONS().tracked_pointers.share(ptr, h->shared ? nullptr : owner, handle, [&](auto & p) {
+                if (p.destroy == nullptr) {
+                    p.count = h->count;
+                    p.size = h->size;
+                    p.adopted = false;
+                    p.destroy = &destroy_header_record;
+                    p.context = h;
+                }
+                h->shared = true;
+            });
+            own(ptr);
+            return true;
+        }
+
+        template <typename T>
+        static void destroy_header(Header * h) {
+            size_t bytes = sizeof(T)*h->count;
+            size_t block_size = sizeof(Header) + bytes + (h->cached ? 0 : header_slack);
+            uint8_t * block = reinterpret_cast<uint8_t*>(h) - h->pad;
+            destroy_elements<T>(h + 1, h->count);
+            auto & singleton = GET_SINGLETONS();
+            if (!h->listed) {
+                // the override's, neither zeroed nor accounted one at a time
+                singleton.account_unlisted_free(bytes, block_size - bytes);
+                *reinterpret_cast<volatile size_t*>(&h->cookie) = 0;
+                if (h->cached) {
+                    singleton.magazines.free(block, block_size, true);
+                } else {
+                    SINGLETONS::inspect_free(block);
+                }
+                return;
+            }
+            if constexpr (StatsPolicy::enabled) {
+                singleton.account_free<T>(bytes);
+                singleton.metadata_usage.fetch_sub(block_size - bytes, std::memory_order_relaxed);
+                singleton.tracked_objects.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if (h->cached) {
+                // wiped by the magazine, including the cookie
+                singleton.magazines.free<WipePolicy>(block, block_size);
+            } else {
+                // a stale pointer must not look like a header allocation, so the cookie goes even without a wipe
+                if constexpr (WipePolicy::wipes) {
+                    WipePolicy::zero(block, block_size);
+                } else {
+                    *reinterpret_cast<volatile size_t*>(&h->cookie) = 0;
+                }
+                SINGLETONS::inspect_free(block);
             }
+        }
+
+        template <void (*on_free)(void * ptr, size_t size)>
+        static void destroy_watched(Header * h) {
+            on_free(h + 1, h->count);
+            destroy_header<uint8_t>(h);
+        }
+
+        // an unlisted allocation is owned by this allocator without entering the list, dealloc_all will not find it
+        template <typename T>
+        [[nodiscard]] T * alloc_with_header(std::size_t count, bool listed = true, bool allow_cache = true) {
+            if (count > (std::numeric_limits<std::size_t>::max() - sizeof(Header) - header_slack) / sizeof(T))
+                throw std::bad_array_new_length();
+
             auto & singleton = GET_SINGLETONS();
-            singleton.mutex.lock();
-            if (onDealloc(p, sizeof(T)*n)) {
+            size_t bytes = sizeof(T)*count;
+            size_t block_size = sizeof(Header) + bytes;
+            uint8_t * block = nullptr;
+            size_t pad = 0;
+            bool cached = BackingPolicy::magazines && allow_cache && SINGLETONS::MAGAZINES::eligible(block_size, alignof(Header));
+            if (cached) {
+                // an unlisted block is the override's, operator new hands out uninitialized memory so it is not zeroed
+                block = static_cast<uint8_t*>(singleton.magazines.alloc(block_size, !listed));
+                if (block != nullptr && (reinterpret_cast<uintptr_t>(block + sizeof(Header)) & (header_page_size - 1)) == 0) {
+                    // the pointer would be page aligned, header_of never looks at those, cached again the block would
+                    // be the next one handed out and every later request of its class would miss the magazine
+                    singleton.magazines.discard(block, block_size);
+                    block = nullptr;
+                }
+                cached = block != nullptr;
+            }
+            if (!cached) {
+                block_size += header_slack;
+                while (true) {
+                    block = static_cast<uint8_t*>(SINGLETONS::inspect_calloc(1, block_size));
+                    if (block != nullptr) {
+                        break;
+                    }
+                    auto handler = std::get_new_handler();
+                    if (handler == nullptr) {
+                        throw std::bad_alloc();
+                    }
+                    handler();
+                }
+                if ((reinterpret_cast<uintptr_t>(block + sizeof(Header)) & (header_page_size - 1)) == 0) {
+                    pad = header_slack;
+                }
+            }
+            if (!listed) {
+                singleton.account_unlisted_alloc(bytes, block_size - bytes);
+            } else if constexpr (StatsPolicy::enabled) {
+                singleton.account_alloc<T>(bytes);
+                singleton.metadata_usage.fetch_add(block_size - bytes, std::memory_order_relaxed);
+                singleton.tracked_objects.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            Header * h = reinterpret_cast<Header*>(block + pad);
+            T * ptr = reinterpret_cast<T*>(h + 1);
+            h->destroy = &destroy_header<T>;
+            h->count = count;
+            h->size = static_cast<uint32_t>(sizeof(T));
+            h->pad = static_cast<uint8_t>(pad);
+            h->cached = cached;
+            h->shared = false;
+            h->cookie = header_cookie(ptr);
+            if (listed) {
+                link(h);
+            } else {
+                h->prev = nullptr;
+                h->next = nullptr;
+                h->owner = handle;
+                h->unlink = &unlink_from;
+                h->listed = false;
+                // read first, every thread allocates through the handle of the global allocator
+                if (!handle->pinned.load(std::memory_order_relaxed)) {
+                    handle->pinned.store(true, std::memory_order_relaxed);
+                }
+            }
+            SA____STACK_ALLOCATOR__EVENT(EVENT::ALLOC, ptr, bytes, SINGLETONS::TYPE_TABLE::index_of<T>(), handle);
+            if constexpr (StatsPolicy::enabled) {
+                this->onAlloc(ptr, bytes);
+            }
+            return ptr;
+        }
+
+        // set while the owned heap is torn down, heap blocks are then released with the heap instead of one by one
+        bool heap_teardown = false;
+
+        Teardown teardown = Teardown::Inline;
+
+        // the header list is handed over as a whole, only the registry records we hold are visited, to drop our
+        // references, the records nobody else references are unlinked here and destroyed by the reclaimer
+        //
+        // returns true if the reclaimer took a batch, it then frees our handle once the batch is done
+        bool defer_teardown() {
+            Header * list;
+            size_t count;
+            {
+                std::lock_guard<LockPolicy> guard(headers_mutex);
+                list = headers;
+                count = header_count;
+                headers = nullptr;
+                headers_tail = nullptr;
+                header_count = 0;
+            }
+            SINGLETONS::PointerInfo ** records = nullptr;
+            size_t unlinked = 0;
+            void ** ptrs;
+            size_t owned_count = take_owned_pointers(&ptrs);
+            if (owned_count != 0) {
+                records = static_cast<SINGLETONS::PointerInfo**>(SINGLETONS::inspect_calloc(owned_count, sizeof(SINGLETONS::PointerInfo*)));
+                if (records == nullptr) {
+                    SINGLETONS::inspect_free(ptrs);
+                    throw std::bad_alloc();
+                }
+                unlinked = GET_SINGLETONS().tracked_pointers.unlink_many(ptrs, owned_count, handle, records);
+                SINGLETONS::inspect_free(ptrs);
+                for (size_t i = 0; i < unlinked; i++) {
+                    // nobody can reach them anymore, see destroy_allocated
+                    records[i]->forget_owner(handle);
+                }
+            }
+            if (list == nullptr && unlinked == 0) {
+                SINGLETONS::inspect_free(records);
+                return false;
+            }
+            GET_RECLAIMER().defer(handle, list, count, records, unlinked, teardown == Teardown::Background);
+            return true;
+        }
+
+        void release_heap() {
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            if (heap != nullptr) {
+                // blocks still shared with other allocators migrate to the default heap and stay valid
+                alloc_hook_heap_delete(heap);
+                heap = nullptr;
+            }
+#endif
+        }
+
+        void dealloc_all(bool reuse_heap) {
+            // it is about to be freed with the rest
+            std_cache.store(nullptr, std::memory_order_release);
+            // one at a time, destructors may deallocate or allocate more of our objects
+            OWNER_HANDLE * owner;
+            OWNER_HANDLE * retired;
+            while (Header * h = pop_header(owner, retired)) {
+                on_unlinked(h);
+                finish_header(h, owner, retired);
+            }
+            bool scan_registry = false;
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+            // an owned heap knows every block we allocated, so only the registry entries of those blocks are visited,
+            // when the heap can not be visited we fall back to scanning the whole registry
+            if (heap != nullptr && !teardown_heap(reuse_heap)) {
+                scan_registry = true;
+            }
+#endif
+            // a batch at a time, destructors may adopt more pointers
+            while (true) {
+                void ** ptrs;
+                size_t count = take_owned_pointers(&ptrs);
+                if (count == 0) {
+                    break;
+                }
+                // stale entries and pointers an earlier destructor already deallocated are not found
+                GET_SINGLETONS().tracked_pointers.unref_many(ptrs, count, handle, false);
+                SINGLETONS::inspect_free(ptrs);
+            }
+            if (scan_registry) {
+                GET_SINGLETONS().tracked_pointers.unref_all(handle);
+            }
+        }
+
+#ifdef SA_STACK_ALLOCATOR__ALLOC_HOOK
+        struct HeapBlocks {
+            void ** blocks = nullptr;
+            size_t count = 0;
+            size_t capacity = 0;
+            bool failed = false;
+        };
+
+        static bool collect_heap_block(const alloc_hook_heap_t * heap, const alloc_hook_heap_area_t * area, void * block, size_t block_size, void * arg) {
+            HeapBlocks & b = *static_cast<HeapBlocks*>(arg);
+            if (block == nullptr) {
+                // called once per area before its blocks
+                return true;
+            }
+            if (b.count == b.capacity) {
+                size_t wanted = b.capacity == 0 ? 64 : b.capacity * 2;
+                // inspect_calloc uses the thread's default heap, never the heap being visited
+                void ** grown = static_cast<void**>(SINGLETONS::inspect_calloc(wanted, sizeof(void*)));
+                if (grown == nullptr) {
+                    b.failed = true;
+                    return false;
+                }
+                for (size_t i = 0; i < b.count; i++) {
+                    grown[i] = b.blocks[i];
+                }
+                SINGLETONS::inspect_free(b.blocks);
+                b.blocks = grown;
+                b.capacity = wanted;
+            }
+            b.blocks[b.count++] = block;
+            return true;
+        }
+
+        // runs the destructors of everything allocated from the owned heap, then releases all of its pages at once with
+        // alloc_hook_heap_destroy, cost is proportional to this heap's pages instead of every tracked pointer
+        //
+        // a block that was released or is shared with another allocator must outlive us, the heap is then deleted
+        // instead which moves the surviving blocks to the default heap
+        //
+        // returns false if the blocks could not be collected, nothing has been deallocated in that case
+        bool teardown_heap(bool reuse_heap) {
+            HeapBlocks b;
+            alloc_hook_heap_visit_blocks(heap, true, collect_heap_block, &b);
+            if (b.failed) {
+                SINGLETONS::inspect_free(b.blocks);
+                return false;
+            }
+            auto & tracked = GET_SINGLETONS().tracked_pointers;
+            bool keep = false;
+            for (size_t i = 0; i < b.count && !keep; i++) {
+                keep = !tracked.is_sole_owner(b.blocks[i], handle);
+            }
+            heap_teardown = !keep;
+            for (size_t i = 0; i < b.count; i++) {
+                // an earlier destructor may have already deallocated this pointer
+                tracked.unref(b.blocks[i], handle, false);
+            }
+            heap_teardown = false;
+            SINGLETONS::inspect_free(b.blocks);
+            if (keep) {
+                alloc_hook_heap_delete(heap);
+            } else {
+                alloc_hook_heap_destroy(heap);
+            }
+            heap = nullptr;
+            if (reuse_heap) {
+                heap = alloc_hook_heap_new();
+                if (heap == nullptr) {
+                    throw std::bad_alloc();
+                }
+            }
+            return true;
+        }
+#endif
+
+        template <typename T>
+        static void delete_object(void * p) {
+            delete static_cast<T*>(p);
+        }
+
+        // what a record of an adopted T * is sized with, adopt accepts void pointers
+        template <typename T>
+        static constexpr uint32_t element_size() {
+            if constexpr (std::is_void<T>::value) {
+                return 0;
+            } else {
+                return static_cast<uint32_t>(sizeof(T));
+            }
+        }
+
+        // record destroy functions, see SINGLETONS::PointerInfo
+
+        static void destroy_adopted(SINGLETONS::PointerInfo & p) {
+            if (p.pointer != nullptr) {
+                p.deleter(p.pointer);
+            }
+        }
+
+        template <typename D>
+        static void destroy_bound(SINGLETONS::PointerInfo & p) {
+            D * bound = static_cast<D*>(p.context);
+            if (p.pointer != nullptr) {
+                (*bound)(p.pointer);
+            }
+            SINGLETONS::dealloc(&bound);
+            GET_SINGLETONS().metadata_usage.fetch_sub(sizeof(D), std::memory_order_relaxed);
+        }
+
+        // trivially destructible elements have nothing to run
+        template <typename T>
+        static void destroy_elements(void * p, size_t count) {
+            if constexpr (!std::is_trivially_destructible<T>::value) {
+                T * t = static_cast<T*>(p);
+                while (count != 0) {
+                    t[--count].~T();
+                }
+            }
+        }
+
+        template <typename T>
+        static void destroy_cached(SINGLETONS::PointerInfo & p) {
+            if (p.pointer != nullptr) {
+                destroy_elements<T>(p.pointer, p.count);
+                auto & singleton = GET_SINGLETONS();
+                singleton.magazines.free<WipePolicy>(p.pointer, sizeof(T)*p.count);
+                singleton.account_free<T>(sizeof(T)*p.count);
+                on_record_freed(p, sizeof(T)*p.count);
+            }
+        }
+
+        template <typename T>
+        static void destroy_allocated(SINGLETONS::PointerInfo & p) {
+            if (p.pointer != nullptr) {
+                destroy_elements<T>(p.pointer, p.count);
+                // a record handed to the reclaimer no longer knows its allocator, which never owned a heap
+                if (p.context != nullptr && allocator_of(p.context)->heap_teardown) {
+                    // the block goes away with the heap, only drop its bookkeeping
+                    auto & singleton = GET_SINGLETONS();
+                    singleton.pointers.remove_pointer(p.pointer);
+                    singleton.account_free<T>(sizeof(T)*p.count);
+                } else {
+                    GET_TRACKED_MALLOCATOR<T, WipePolicy>().deallocate(static_cast<T*>(p.pointer), p.count);
+                }
+                on_record_freed(p, sizeof(T)*p.count);
+            }
+        }
+
+        // the context is the handle of the allocating allocator as long as it references the record, see
+        // PointerInfo::forget_owner
+        static void on_record_freed(SINGLETONS::PointerInfo & p, size_t bytes) {
+            if constexpr (StatsPolicy::enabled) {
+                if (p.context != nullptr) {
+                    allocator_of(p.context)->onDealloc(p.pointer, bytes);
+                }
+            }
+        }
+
+        // returns true if this call created the record, otherwise the pointer was already tracked and keeps its deleter
+        bool adopt_internal(void * ptr, uint32_t size, void (*deleter)(void*), void (*destroy)(SINGLETONS::PointerInfo&), void * context) {
+            bool created = false;
+            join_directory();
+            GET_SINGLETONS().tracked_pointers.ref(ptr, handle, [&](auto & p) {
+                if (p.destroy == nullptr) {
+                    p.count = 1;
+                    p.size = size;
+                    p.adopted = true;
+                    if (deleter != nullptr) {
+                        p.destroy = &destroy_adopted;
+                        p.deleter = deleter;
+                    } else {
+                        p.destroy = destroy;
+                        p.context = context;
+                    }
+                    created = true;
+                }
+            });
+            own(ptr);
+            return created;
+        }
+
+        template <typename T>
+        [[nodiscard]] T * alloc_internal(std::size_t count) {
+            if (count > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_array_new_length();
+
+#if SA_STACK_ALLOCATOR__HEADER_LAYOUT
+            // blocks of an owned heap are found by visiting the heap instead
+            if (heap == nullptr && alignof(T) <= alignof(Header)) {
+                return alloc_with_header<T>(count);
+            }
+#endif
+            auto & singleton = GET_SINGLETONS();
+            T * ptr = nullptr;
+            // small requests are served from this thread's magazine without touching the allocation lock or calloc
+            // unless this allocator owns a heap, whose blocks must all come from that heap
+            bool cached = BackingPolicy::magazines && heap == nullptr && SINGLETONS::MAGAZINES::eligible(sizeof(T)*count, alignof(T));
+            if (cached) {
+                ptr = static_cast<T*>(singleton.magazines.alloc(sizeof(T)*count));
+                if (ptr != nullptr) {
+                    singleton.account_alloc<T>(sizeof(T)*count);
+                } else {
+                    cached = false;
+                }
+            }
+            if (!cached) {
+                ptr = GET_TRACKED_MALLOCATOR<T, WipePolicy>().allocate(count, heap);
+            }
+            if (heap == nullptr) {
+                join_directory();
+            }
+            singleton.tracked_pointers.ref(ptr, handle, [&](auto & p) {
+                if (p.destroy == nullptr) {
+                    p.count = count;
+                    p.size = static_cast<uint32_t>(sizeof(T));
+                    SA____STACK_ALLOCATOR__EVENT(EVENT::ALLOC, p.pointer, sizeof(T)*p.count, SINGLETONS::TYPE_TABLE::index_of<T>(), handle);
+                    if constexpr (StatsPolicy::enabled) {
+                        this->onAlloc(p.pointer, sizeof(T)*p.count);
+                    }
+                    p.adopted = false;
+                    p.destroy = cached ? &destroy_cached<T> : &destroy_allocated<T>;
+                    p.context = handle;
+                }
+            });
+            // blocks of an owned heap are found by visiting the heap instead
+            if (heap == nullptr) {
+                own(ptr);
+            }
+            return ptr;
+        }
+
+        // pointers carrying a header are adopted one by one, the rest are referenced in one registry batch, with a
+        // stateful deleter D every registry pointer gets its own bound copy, built before taking any shard lock since
+        // nothing under it may call operator new
+        template <typename T, typename D>
+        void adopt_many_internal(T * const * ptrs, size_t count, void (*deleter)(void*), D * destructor) {
+            constexpr bool bound = !std::is_void<D>::value;
+            void ** rest = nullptr;
+            size_t remaining = 0;
+            for (size_t i = 0; i < count; i++) {
+                void * ptr = const_cast<void*>(static_cast<const void*>(ptrs[i]));
+                if (ptr == nullptr) {
+                    continue;
+                }
+                SA____STACK_ALLOCATOR__EVENT(EVENT::ADOPT, ptr, 0, SINGLETONS::TYPE_TABLE::index_of<T>(), handle);
+                if (adopt_header(ptr)) {
+                    continue;
+                }
+                if (rest == nullptr) {
+                    // the bound deleters follow the pointers
+                    rest = static_cast<void**>(SINGLETONS::inspect_calloc(bound ? count * 2 : count, sizeof(void*)));
+                    if (rest == nullptr) throw std::bad_alloc();
+                }
+                rest[remaining++] = ptr;
+            }
+            if (remaining == 0) {
+                return;
+            }
+            void ** contexts = rest + count;
+            if constexpr (bound) {
+                for (size_t i = 0; i < remaining; i++) {
+                    contexts[i] = SINGLETONS::alloc<D>(*destructor);
+                }
+            }
+            size_t created = 0;
+            join_directory();
+            GET_SINGLETONS().tracked_pointers.ref_many(rest, remaining, handle, [&](size_t i, auto & p) {
+                if (p.destroy == nullptr) {
+                    p.count = 1;
+                    p.size = element_size<T>();
+                    p.adopted = true;
+                    if constexpr (bound) {
+                        p.destroy = &destroy_bound<D>;
+                        p.context = contexts[i];
+                        contexts[i] = nullptr;
+                        created++;
+                    } else {
+                        p.destroy = &destroy_adopted;
+                        p.deleter = deleter;
+                    }
+                }
+            });
+            if constexpr (bound) {
+                for (size_t i = 0; i < remaining; i++) {
+                    // the pointer was already tracked and keeps its deleter
+                    D * unused = static_cast<D*>(contexts[i]);
+                    SINGLETONS::dealloc(&unused);
+                }
+                GET_SINGLETONS().metadata_usage.fetch_add(sizeof(D) * created, std::memory_order_relaxed);
+            }
+            {
+                std::lock_guard<LockPolicy> guard(headers_mutex);
+                for (size_t i = 0; i < remaining; i++) {
+                    own_locked(rest[i]);
+                }
+            }
+            SINGLETONS::inspect_free(rest);
+        }
+
+        void internal_dealloc(void * ptr) {
+            GET_SINGLETONS().tracked_pointers.unref(ptr, handle);
+            disown(ptr);
+        }
+
+        void own(void * ptr) {
+            std::lock_guard<LockPolicy> guard(headers_mutex);
+            own_locked(ptr);
+        }
+
+        void own_locked(void * ptr) {
+            bool found;
+            owned.find_or_add(ptr, found) = true;
+        }
+
+        // returns false if ptr was not in the owned set
+        bool disown(void * ptr) {
+            std::lock_guard<LockPolicy> guard(headers_mutex);
+            return owned.remove(ptr);
+        }
+
+        static void disown_from(void * owner, void * ptr) {
+            allocator_of(owner)->disown(ptr);
+        }
+
+        // called before referencing a registry record, a release() racing with the reference can still leave an entry
+        // behind, dealloc_all then finds nothing to drop for it
+        void join_directory() {
+            if (!in_directory.load(std::memory_order_relaxed)) {
+                GET_SINGLETONS().owner_directory.add(handle, &disown_from);
+                in_directory.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        void leave_directory() {
+            if (in_directory.load(std::memory_order_relaxed)) {
+                GET_SINGLETONS().owner_directory.remove(handle);
+                in_directory.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        // moves every set entry out under the lock, returns the number of pointers written to *out
+        size_t take_owned_pointers(void *** out) {
+            std::lock_guard<LockPolicy> guard(headers_mutex);
+            *out = nullptr;
+            size_t count = owned.size;
+            if (count == 0) {
+                return 0;
+            }
+            *out = static_cast<void**>(SINGLETONS::inspect_calloc(count, sizeof(void*)));
+            if (*out == nullptr) {
+                throw std::bad_alloc();
+            }
+            size_t i = 0;
+            owned.for_each([&](void * key, bool &) {
+                (*out)[i++] = key;
+            });
+            owned.clear();
+            return count;
+        }
+
+        // the registry references from holds on ptrs become ours, so do the records it allocated, returns their bytes
+        size_t rebind(void * const * ptrs, size_t count, OWNER_HANDLE * from) {
+            if (count == 0) {
+                return 0;
+            }
+            size_t bytes = 0;
+            join_directory();
+            GET_SINGLETONS().tracked_pointers.reown_many(ptrs, count, from, handle, [&](auto & p) {
+                if (!p.adopted && p.context == static_cast<void*>(from)) {
+                    p.context = handle;
+                    bytes += static_cast<size_t>(p.size)*p.count;
+                }
+            });
+            {
+                std::lock_guard<LockPolicy> guard(headers_mutex);
+                for (size_t i = 0; i < count; i++) {
+                    own_locked(ptrs[i]);
+                }
+            }
+            return bytes;
+        }
+    };
+
+    struct TrackedAllocator : BasicAllocator<MutexLock, TypeStats, MagazineBacking, FastWipe> {
+        using BasicAllocator::BasicAllocator;
+    };
+
+    // for short lived single thread scopes, nothing is locked, accounted or securely wiped
+    using LocalAllocator = BasicAllocator<NoLock, NoStats, MagazineBacking, NoWipe>;
+
+    // keeps the current, peak and total bytes of what it allocated and still owns, shown by
+    // GET_SINGLETONS().snapshot(), an allocation shared with another allocator is counted until this one lets go of it
+    class TrackedAllocatorWithMemUsage : public TrackedAllocator {
+        SINGLETONS::ALLOCATOR_USAGE usage;
+
+        public:
+
+        TrackedAllocatorWithMemUsage() {
+            GET_SINGLETONS().allocator_usage.add(usage, this);
+        }
+
+        explicit TrackedAllocatorWithMemUsage(bool own_heap) : TrackedAllocator(own_heap) {
+            GET_SINGLETONS().allocator_usage.add(usage, this);
+        }
+
+        TrackedAllocatorWithMemUsage(const TrackedAllocatorWithMemUsage & other) = delete;
+        TrackedAllocatorWithMemUsage & operator=(const TrackedAllocatorWithMemUsage & other) = delete;
+
+        // the allocations move along with their usage
+        TrackedAllocatorWithMemUsage(TrackedAllocatorWithMemUsage && other) : TrackedAllocator(std::move(other)) {
+            usage.counter.merge(other.usage.counter);
+            GET_SINGLETONS().allocator_usage.add(usage, this);
+        }
+
+        TrackedAllocatorWithMemUsage & operator=(TrackedAllocatorWithMemUsage && other) {
+            if (this != &other) {
+                TrackedAllocator::operator=(std::move(other));
+                usage.counter.merge(other.usage.counter);
+            }
+            return *this;
+        }
+
+        MemoryUsage memory_usage() const {
+            return usage.counter.load();
+        }
+
+        // an inline teardown runs here while onDealloc still reaches our counter, a deferred one is left to
+        // ~BasicAllocator and what it hands over stops counting towards us right away
+        ~TrackedAllocatorWithMemUsage() {
+            auto n = usage.counter.load().current;
+            if (tears_down_inline()) {
                 if (log) {
                     Logib();
-                    printf("deallocating %zu bytes of memory, total memory usage for '%s': %zu bytes. total memory usage: %zu bytes\n", sizeof(T)*n, singleton.per_type<T>().demangled, singleton.per_type<T>().memory_usage, singleton.memory_usage);
+                    printf("deallocating %zu bytes of memory\n", n);
                     Logr();
+                }
+
+                dealloc_all();
+
+                if (log) {
                     Logib();
-                    printf("logging contents\n");
+                    printf("deallocated %zu bytes of memory\n", n);
                     Logr();
-                    Logw(CustomHexdump<16, true, uint8_t>("ptr: ", p, sizeof(T)*n));
                 }
-                secure_free(p, n);
-            } else {
-                Logeb();
-                printf("error: pointer %p could not be found in the list of allocated pointers, ignoring\n", p);
+            } else if (log) {
+                Logib();
+                printf("deferring %zu bytes of memory\n", n);
                 Logr();
             }
-            singleton.mutex.unlock();
+
+            GET_SINGLETONS().allocator_usage.remove(usage);
+        }
+
+        protected:
+
+        void onAlloc(void * p, std::size_t n) override {
+            usage.counter.add(n);
+        }
+
+        void onDealloc(void * p, std::size_t n) override {
+            usage.counter.sub(n);
+        }
+
+        SINGLETONS::USAGE_COUNTER * usageCounter() override {
+            return &usage.counter;
         }
     };
 
-    template<typename T>
-    struct TrackedMallocator : public Mallocator<T>
-    {
-        using Mallocator<T>::Mallocator;
+    // a real stack/region allocator
+    //
+    // objects are carved from chained chunks with a bump pointer, non trivial destructors are recorded in a compact side
+    // list and run in LIFO order, then every chunk is released at once
+    //
+    // memory is zeroed just like TrackedAllocator's, nothing is freed individually and nothing is registered with the
+    // global pointer registry, a RegionAllocator must only be used from one thread at a time
+    class RegionAllocator : public AllocatorBase {
+        struct Chunk {
+            Chunk * prev;
+            size_t size;
+        };
 
-        void onAlloc(T * p, std::size_t n) override {
-            GET_SINGLETONS().pointers.add_pointer(p);
+        struct Destructor {
+            void (*destroy)(void*);
+            void * pointer;
+        };
+
+        struct DestructorBlock {
+            static constexpr size_t capacity = 32;
+            DestructorBlock * prev;
+            size_t count;
+            Destructor records[capacity];
+        };
+
+        static constexpr size_t max_chunk_size = 1024 * 1024;
+
+        Chunk * chunks = nullptr;
+        uint8_t * cursor = nullptr;
+        uint8_t * limit = nullptr;
+        size_t initial_chunk_size;
+        size_t next_chunk_size;
+        DestructorBlock * destructors = nullptr;
+        // see std_node_cache
+        STD_NODE_CACHE<NoLock> * std_cache = nullptr;
+
+        template <typename T>
+        static void destroy_object(void * p) {
+            static_cast<T*>(p)->~T();
         }
-    
-        bool onDealloc(T * p, std::size_t n) override {
-            return GET_SINGLETONS().pointers.remove_pointer(p);
+
+        template <typename T>
+        struct Array {
+            T * pointer;
+            size_t count;
+        };
+
+        template <typename T>
+        static void destroy_array(void * p) {
+            Array<T> * a = static_cast<Array<T>*>(p);
+            while (a->count != 0) {
+                a->pointer[--a->count].~T();
+            }
+        }
+
+        template <typename T>
+        static void delete_object(void * p) {
+            delete static_cast<T*>(p);
+        }
+
+        Chunk * new_chunk(size_t bytes) {
+            Chunk * chunk = static_cast<Chunk*>(SINGLETONS::inspect_calloc(1, bytes));
+            if (chunk == nullptr) {
+                throw std::bad_alloc();
+            }
+            chunk->size = bytes;
+            GET_SINGLETONS().account_alloc<RegionAllocator>(bytes);
+            return chunk;
+        }
+
+        static uint8_t * align_up(uint8_t * p, size_t alignment) {
+            uintptr_t v = reinterpret_cast<uintptr_t>(p);
+            return reinterpret_cast<uint8_t*>((v + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+        }
+
+        void * carve_slow(size_t size, size_t alignment) {
+            if (size > std::numeric_limits<size_t>::max() - sizeof(Chunk) - alignment) {
+                throw std::bad_array_new_length();
+            }
+            size_t needed = sizeof(Chunk) + alignment + size;
+            if (needed > next_chunk_size) {
+                // too big for a regular chunk, give it a dedicated one behind the current chunk and keep bumping there
+                Chunk * chunk = new_chunk(needed);
+                if (chunks == nullptr) {
+                    chunk->prev = nullptr;
+                    chunks = chunk;
+                } else {
+                    chunk->prev = chunks->prev;
+                    chunks->prev = chunk;
+                }
+                return align_up(reinterpret_cast<uint8_t*>(chunk + 1), alignment);
+            }
+            Chunk * chunk = new_chunk(next_chunk_size);
+            chunk->prev = chunks;
+            chunks = chunk;
+            cursor = reinterpret_cast<uint8_t*>(chunk + 1);
+            limit = reinterpret_cast<uint8_t*>(chunk) + chunk->size;
+            if (next_chunk_size < max_chunk_size) {
+                next_chunk_size *= 2;
+            }
+            uint8_t * p = align_up(cursor, alignment);
+            cursor = p + size;
+            return p;
+        }
+
+        void * carve(size_t size, size_t alignment) {
+            if (cursor != nullptr) {
+                uint8_t * p = align_up(cursor, alignment);
+                if (p <= limit && size <= static_cast<size_t>(limit - p)) {
+                    cursor = p + size;
+                    return p;
+                }
+            }
+            return carve_slow(size, alignment);
         }
-    };
 
-    template <typename T>
-    static TrackedMallocator<T> & GET_TRACKED_MALLOCATOR() {
-        static TrackedMallocator<T> m;
-        return m;
-    }
+        void push_destructor(void (*destroy)(void*), void * pointer) {
+            if (destructors == nullptr || destructors->count == DestructorBlock::capacity) {
+                DestructorBlock * block = static_cast<DestructorBlock*>(carve(sizeof(DestructorBlock), alignof(DestructorBlock)));
+                block->prev = destructors;
+                block->count = 0;
+                destructors = block;
+            }
+            destructors->records[destructors->count++] = {destroy, pointer};
+        }
 
-    struct TrackedAllocator : AllocatorBase {
+        public:
 
-        TrackedAllocator() {}
+        explicit RegionAllocator(size_t initial_chunk_size = 4096) : initial_chunk_size(initial_chunk_size), next_chunk_size(initial_chunk_size) {}
 
-        TrackedAllocator(const TrackedAllocator & other) = delete;
-        TrackedAllocator & operator=(const TrackedAllocator & other) = delete;
+        RegionAllocator(const RegionAllocator & other) = delete;
+        RegionAllocator & operator=(const RegionAllocator & other) = delete;
 
-        TrackedAllocator(TrackedAllocator && other) = default;
-        TrackedAllocator & operator=(TrackedAllocator && other) = default;
-        
-        template <typename T>
-        void adopt(T * ptr, std::function<void(void*)> destructor = [](void*p){ delete static_cast<T*>(p); }) {
-            auto & singleton = GET_SINGLETONS();
-            singleton.mutex.lock();
-            auto & p = singleton.tracked_pointers.ref(ptr, this);
-            if (p.refs.size == 1) {
-                p.count = 1;
-                p.adopted = true;
-                p.t_destructor = destructor;
-                p.destructor = [this](auto & p) {
-                    if (p.pointer != nullptr) {
-                        p.t_destructor(p.pointer);
-                        p.pointer = nullptr;
-                        p.adopted = false;
-                        p.count = 0;
-                    }
-                };
+        RegionAllocator(RegionAllocator && other) noexcept {
+            *this = std::move(other);
+        }
+
+        RegionAllocator & operator=(RegionAllocator && other) noexcept {
+            if (this != &other) {
+                if (chunks != nullptr) {
+                    dealloc_all();
+                }
+                chunks = other.chunks;
+                cursor = other.cursor;
+                limit = other.limit;
+                initial_chunk_size = other.initial_chunk_size;
+                next_chunk_size = other.next_chunk_size;
+                destructors = other.destructors;
+                std_cache = other.std_cache;
+                other.chunks = nullptr;
+                other.cursor = nullptr;
+                other.limit = nullptr;
+                other.next_chunk_size = other.initial_chunk_size;
+                other.destructors = nullptr;
+                other.std_cache = nullptr;
             }
-            singleton.mutex.unlock();
+            return *this;
         }
 
-        static void release(void * ptr) {
-            auto & singleton = GET_SINGLETONS();
-            singleton.mutex.lock();
-            singleton.tracked_pointers.release(ptr);
-            singleton.mutex.unlock();
+        template <typename T>
+        void adopt(T * ptr) {
+            if (ptr == nullptr) return;
+            push_destructor(&delete_object<T>, ptr);
+        }
+
+        // captureless deleters are recorded as is, anything with state is moved into the region
+        template <typename T, typename D>
+        void adopt(T * ptr, D destructor) {
+            if (ptr == nullptr) return;
+            if constexpr (std::is_convertible<D, void(*)(void*)>::value) {
+                push_destructor(static_cast<void(*)(void*)>(destructor), ptr);
+            } else {
+                struct Bound {
+                    D destructor;
+                    void * pointer;
+                };
+                Bound * bound = new (carve(sizeof(Bound), alignof(Bound))) Bound {std::move(destructor), ptr};
+                push_destructor([](void * p) {
+                    Bound * bound = static_cast<Bound*>(p);
+                    bound->destructor(bound->pointer);
+                    bound->~Bound();
+                }, bound);
+            }
         }
 
         template <typename T, typename ... Args>
         [[nodiscard]] T* alloc(Args && ... args) {
-            T * ptr = alloc_internal<T>(1, [] (void * ptr) { static_cast<T*>(ptr)->~T(); });
-            new (ptr) T(std::forward<Args>(args)...);
+            T * ptr = new (carve(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if constexpr (!std::is_trivially_destructible<T>::value) {
+                push_destructor(&destroy_object<T>, ptr);
+            }
             return ptr;
         }
 
         template <typename T>
         [[nodiscard]] T* allocArray(size_t count) {
-            T * ptr = alloc_internal<T>(count, [] (void * ptr) {});
-            new (ptr) T[count];
-            return ptr;
+            if (count > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_array_new_length();
+            T * ptr = static_cast<T*>(carve(sizeof(T)*count, alignof(T)));
+            if constexpr (std::is_trivially_default_constructible<T>::value && std::is_trivially_destructible<T>::value) {
+                return ptr;
+            } else {
+                Array<T> * array = nullptr;
+                if constexpr (!std::is_trivially_destructible<T>::value) {
+                    array = static_cast<Array<T>*>(carve(sizeof(Array<T>), alignof(Array<T>)));
+                    array->pointer = ptr;
+                    array->count = 0;
+                    push_destructor(&destroy_array<T>, array);
+                }
+                for (size_t i = 0; i < count; i++) {
+                    // counted as we go, a throwing constructor leaves only the constructed elements to be destroyed
+                    new (ptr + i) T;
+                    if (array != nullptr) {
+                        array->count++;
+                    }
+                }
+                return ptr;
+            }
         }
 
         [[nodiscard]] void * alloc(std::size_t s) {
-            return alloc_internal<uint8_t>(s, [] (void * ptr) {});
+            return carve(s, alignof(std::max_align_t));
         }
 
-        void dealloc(void* ptr) {
-            if (ptr == nullptr) {
-                return;
-            }
-            internal_dealloc(ptr, [] (void * a, void * b) { return a == b; } );
+        // alignment must be a power of two
+        [[nodiscard]] void * alloc(std::size_t s, std::size_t alignment) {
+            return carve(s, alignment < alignof(std::max_align_t) ? alignof(std::max_align_t) : alignment);
         }
 
+        // the node cache of every ScopedStdAllocator bound to this region, carved on first use
+        STD_NODE_CACHE<NoLock> * std_node_cache();
+
+        // runs every recorded destructor in LIFO order and releases every chunk, the region may be reused afterwards
         void dealloc_all() {
-            internal_dealloc(nullptr, [] (void * a, void * b) { return a != nullptr; } );
+            std_cache = nullptr;
+            while (destructors != nullptr) {
+                DestructorBlock * block = destructors;
+                if (block->count == 0) {
+                    destructors = block->prev;
+                    continue;
+                }
+                Destructor d = block->records[--block->count];
+                d.destroy(d.pointer);
+            }
+            size_t released = 0;
+            while (chunks != nullptr) {
+                Chunk * prev = chunks->prev;
+                released += chunks->size;
+                SINGLETONS::inspect_free(chunks);
+                chunks = prev;
+            }
+            if (released != 0) {
+                GET_SINGLETONS().account_free<RegionAllocator>(released);
+            }
+            cursor = nullptr;
+            limit = nullptr;
+            next_chunk_size = initial_chunk_size;
         }
 
-        virtual ~TrackedAllocator() {
+        ~RegionAllocator() {
             dealloc_all();
         }
+    };
 
-        protected:
+    using Allocator = TrackedAllocator;
+    using AllocatorWithMemUsage = TrackedAllocatorWithMemUsage;
 
-        virtual void onAlloc(void * p, std::size_t n) {}
-        virtual void onDealloc(void * p, std::size_t n) {}
+    using DefaultAllocator = Allocator;
+    using DefaultAllocatorWithMemUsage = AllocatorWithMemUsage;
 
-        private:
+    // BasicAllocator only aligns to alignof(std::max_align_t), larger alignments over allocate and keep the block's
+    // address right before the object
+    struct OVER_ALIGNED {
+        static bool over_aligned(std::size_t alignment) {
+            return alignment > alignof(std::max_align_t);
+        }
 
-        template <typename T>
-        [[nodiscard]] T * alloc_internal(std::size_t count, std::function<void(void*)> destructor) {
-            T * ptr = GET_TRACKED_MALLOCATOR<T>().allocate(count);
-            auto & singleton = GET_SINGLETONS();
-            singleton.mutex.lock();
-            auto & p = singleton.tracked_pointers.ref(ptr, this);
-            if (p.refs.size == 1) {
-                onAlloc(p.pointer, sizeof(T)*p.count);
-                p.count = 1;
-                p.adopted = false;
-                p.t_destructor = destructor;
-                p.destructor = [this](auto & p) {
-                    if (p.pointer != nullptr) {
-                        //onDealloc(p.pointer, sizeof(T)*p.count);
-                        p.t_destructor(p.pointer);
-                        GET_TRACKED_MALLOCATOR<T>().deallocate(static_cast<T*>(p.pointer), p.count);
-                        p.pointer = nullptr;
-                        p.adopted = false;
-                        p.count = 0;
-                    }
-                };
+        template <typename A>
+        static void * alloc(A & allocator, std::size_t bytes, std::size_t alignment) {
+            if (!over_aligned(alignment)) {
+                return allocator.alloc(bytes);
             }
-            singleton.mutex.unlock();
-            return ptr;
+            if (bytes > std::numeric_limits<std::size_t>::max() - alignment) {
+                throw std::bad_array_new_length();
+            }
+            uint8_t * block = static_cast<uint8_t*>(allocator.alloc(bytes + alignment));
+            uintptr_t p = reinterpret_cast<uintptr_t>(block + sizeof(void*));
+            void ** aligned = reinterpret_cast<void**>((p + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+            aligned[-1] = block;
+            return aligned;
         }
 
-        void internal_dealloc(void * ptr, std::function<bool(void*,void*)> pred) {
-            auto & singleton = GET_SINGLETONS();
-            singleton.mutex.lock();
-            singleton.tracked_pointers.unref(ptr, this, [&](void* a, void* b) { return pred(a, b); });
-            singleton.mutex.unlock();
+        template <typename A>
+        static void dealloc(A & allocator, void * p, std::size_t alignment) {
+            if (p == nullptr) {
+                return;
+            }
+            if (over_aligned(alignment)) {
+                p = static_cast<void**>(p)[-1];
+            }
+            allocator.dealloc(p);
         }
     };
 
-    class TrackedAllocatorWithMemUsage : public TrackedAllocator {
-        size_t memory_usage = 0;
+    // a std::pmr::memory_resource that allocates from one specific BasicAllocator, blocks are owned by that allocator
+    // so anything a container did not give back is freed when the allocator is, the allocator must outlive every
+    // container using the resource
+    //
+    template <typename A = Allocator>
+    class TrackedResource : public std::pmr::memory_resource {
+        A & allocator;
+
+        protected:
+
+        void * do_allocate(std::size_t bytes, std::size_t alignment) override {
+            return OVER_ALIGNED::alloc(allocator, bytes, alignment);
+        }
+
+        void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override {
+            OVER_ALIGNED::dealloc(allocator, p, alignment);
+        }
 
-        Mallocator<std::mutex> mutex_allocator;
-        std::mutex * mutex = nullptr;
+        bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override {
+            return this == &other;
+        }
 
         public:
 
-        using TrackedAllocator::TrackedAllocator;
+        explicit TrackedResource(A & allocator) : allocator(allocator) {}
 
-        TrackedAllocatorWithMemUsage() {
-            mutex = mutex_allocator.allocate(1);
+        TrackedResource(const TrackedResource & other) = delete;
+        TrackedResource & operator=(const TrackedResource & other) = delete;
+
+        A & get_allocator() const {
+            return allocator;
         }
+    };
 
-        TrackedAllocatorWithMemUsage(const TrackedAllocatorWithMemUsage & other) = delete;
-        TrackedAllocatorWithMemUsage & operator=(const TrackedAllocatorWithMemUsage & other) = delete;
+    // a std::pmr::memory_resource carving from a RegionAllocator, deallocate does nothing and the memory comes back
+    // when the region is cleared or destroyed, like std::pmr::monotonic_buffer_resource
+    class RegionResource : public std::pmr::memory_resource {
+        RegionAllocator & region;
+
+        protected:
 
-        TrackedAllocatorWithMemUsage(TrackedAllocatorWithMemUsage && other) = default;
-        TrackedAllocatorWithMemUsage & operator=(TrackedAllocatorWithMemUsage && other) = default;
+        void * do_allocate(std::size_t bytes, std::size_t alignment) override {
+            return region.alloc(bytes, alignment);
+        }
 
-        ~TrackedAllocatorWithMemUsage() {
-            auto n = memory_usage;
-            Logib();
-            printf("deallocating %zu bytes of memory\n", n);
-            Logr();
+        void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override {}
 
-            dealloc_all();
+        bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override {
+            return this == &other;
+        }
 
-            Logib();
-            printf("deallocated %zu bytes of memory\n", n);
-            Logr();
+        public:
+
+        explicit RegionResource(RegionAllocator & region) : region(region) {}
+
+        RegionResource(const RegionResource & other) = delete;
+        RegionResource & operator=(const RegionResource & other) = delete;
 
-            mutex_allocator.deallocate(mutex, sizeof(std::mutex));
-            mutex = nullptr;
+        RegionAllocator & get_allocator() const {
+            return region;
         }
+    };
 
-        protected:
+    // the size classes of STD_NODE_CACHE, requests of up to max_size bytes in steps of granularity
+    struct STD_NODE_SIZES {
+        static constexpr size_t granularity = alignof(std::max_align_t);
+        static constexpr size_t max_size = 256;
+        static constexpr size_t classes = max_size / granularity;
+        static constexpr size_t batch = 32;
 
-        void onAlloc(void * p, std::size_t n) override {
-            mutex->lock();
-            memory_usage += n;
-            mutex->unlock();
+        static bool eligible(size_t bytes, size_t alignment) {
+            return bytes != 0 && bytes <= max_size && alignment <= granularity;
         }
 
-        void onDealloc(void * p, std::size_t n) override {
-            mutex->lock();
-            memory_usage -= n;
-            mutex->unlock();
+        static size_t class_of(size_t bytes) {
+            return (bytes - 1) / granularity;
         }
     };
 
-    using Allocator = TrackedAllocator;
-    using AllocatorWithMemUsage = TrackedAllocatorWithMemUsage;
+    // free lists of small blocks shared by every ScopedStdAllocator bound to one allocator, blocks are carved in batches
+    // from that allocator and recycled here instead of being given back, they return to the system with the allocator
+    //
+    // the lists are guarded by a lock of the allocator's LockPolicy, a batch is carved with the lock released so the
+    // allocator may take its own
+    template <typename LockPolicy>
+    struct STD_NODE_CACHE : STD_NODE_SIZES {
+        struct Node {
+            Node * next;
+        };
 
-    using DefaultAllocator = Allocator;
-    using DefaultAllocatorWithMemUsage = AllocatorWithMemUsage;
+        LockPolicy mutex;
+        Node * free[classes] = {};
+
+        template <typename A>
+        void * alloc(A & allocator, size_t bytes) {
+            size_t c = class_of(bytes);
+            {
+                std::lock_guard<LockPolicy> guard(mutex);
+                if (free[c] != nullptr) {
+                    Node * node = free[c];
+                    free[c] = node->next;
+                    return node;
+                }
+            }
+            size_t size = (c + 1) * granularity;
+            uint8_t * block = static_cast<uint8_t*>(allocator.alloc(size * batch));
+            // the first node is ours, the rest go on the list
+            Node * first = reinterpret_cast<Node*>(block + size);
+            Node * last = first;
+            for (size_t i = 2; i < batch; i++) {
+                Node * node = reinterpret_cast<Node*>(block + i * size);
+                last->next = node;
+                last = node;
+            }
+            std::lock_guard<LockPolicy> guard(mutex);
+            last->next = free[c];
+            free[c] = first;
+            return block;
+        }
+
+        void dealloc(void * p, size_t bytes) {
+            size_t c = class_of(bytes);
+            Node * node = static_cast<Node*>(p);
+            std::lock_guard<LockPolicy> guard(mutex);
+            node->next = free[c];
+            free[c] = node;
+        }
+    };
+
+    // a stateful standard allocator bound to one BasicAllocator or RegionAllocator, allocators compare equal when they
+    // are bound to the same instance and propagate with their container on copy, move and swap
+    //
+    // requests of up to STD_NODE_SIZES::max_size bytes (the nodes of std::map, std::list, std::unordered_map, ...) come
+    // from the bound allocator's std_node_cache(), filled in batches and only given back when the bound allocator is
+    // cleared or destroyed, every container bound to one allocator draws from that one cache, which is locked like the
+    // allocator itself, the bound allocator must outlive them
+    template <typename T, typename A = Allocator>
+    struct ScopedStdAllocator {
+        typedef T value_type;
+
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        using is_always_equal = std::false_type;
+
+        explicit ScopedStdAllocator(A & allocator) : allocator(&allocator) {}
+
+        template <typename U>
+        ScopedStdAllocator(const ScopedStdAllocator<U, A> & other) noexcept : allocator(other.allocator) {}
+
+        template <typename U>
+        bool operator==(const ScopedStdAllocator<U, A> & other) const noexcept { return allocator == other.allocator; }
+
+        template <typename U>
+        bool operator!=(const ScopedStdAllocator<U, A> & other) const noexcept { return allocator != other.allocator; }
+
+        [[nodiscard]] T * allocate(std::size_t n) {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_array_new_length();
+            if (STD_NODE_SIZES::eligible(sizeof(T)*n, alignof(T))) {
+                return static_cast<T*>(allocator->std_node_cache()->alloc(*allocator, sizeof(T)*n));
+            }
+            if constexpr (std::is_same<A, RegionAllocator>::value) {
+                return static_cast<T*>(allocator->alloc(sizeof(T)*n, alignof(T)));
+            } else {
+                return static_cast<T*>(OVER_ALIGNED::alloc(*allocator, sizeof(T)*n, alignof(T)));
+            }
+        }
+
+        void deallocate(T * p, std::size_t n) noexcept {
+            if (p == nullptr) {
+                return;
+            }
+            if (STD_NODE_SIZES::eligible(sizeof(T)*n, alignof(T))) {
+                allocator->std_node_cache()->dealloc(p, sizeof(T)*n);
+                return;
+            }
+            if constexpr (!std::is_same<A, RegionAllocator>::value) {
+                OVER_ALIGNED::dealloc(*allocator, p, alignof(T));
+            }
+        }
+
+        A & get_allocator() const {
+            return *allocator;
+        }
+
+        private:
+
+        template <typename U, typename B> friend struct ScopedStdAllocator;
+
+        A * allocator;
+    };
+
+    inline STD_NODE_CACHE<NoLock> * RegionAllocator::std_node_cache() {
+        if (std_cache == nullptr) {
+            std_cache = alloc<STD_NODE_CACHE<NoLock>>();
+        }
+        return std_cache;
+    }
 }
 
 #endif
@@ -1039,161 +4948,386 @@ namespace SA {
 #include <stdlib.h>
 #include <limits>
 #include <string.h>
+#include <cmath>
+#include <cstdio>
+#if defined(__has_include)
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define SA____STACK_ALLOCATOR__BACKTRACE 1
+#endif
+#endif
 
-void *operator new(size_t size) {
-    auto & singleton = SA::GET_SINGLETONS();
+namespace SA {
+    struct HEAP_PROFILER;
+    extern HEAP_PROFILER & GET_HEAP_PROFILER();
+
+    // samples the operator new override allocations and attributes their bytes to the stack that allocated them
+    //
+    // every thread counts down the bytes it allocates, the allocation that crosses zero is sampled and the next
+    // distance is drawn from an exponential distribution with a mean of SA_STACK_ALLOCATOR__HEAP_PROFILE_INTERVAL bytes,
+    // so the fast path is a thread local subtraction and a large allocation is always sampled
+    //
+    // a sample captures the stack with backtrace() and is counted under it as allocated and live, it stops being
+    // live when the block is destroyed, samples are found on free through their header, so nothing else pays for it
+    //
+    // write() produces a legacy pprof heap profile (heap_v2) holding the raw samples, pprof scales them back up using
+    // the interval in its header, it is written at exit to the file named by SA_STACK_ALLOCATOR_HEAP_PROFILE if set
+    struct HEAP_PROFILER {
+        static constexpr size_t interval = SA_STACK_ALLOCATOR__HEAP_PROFILE_INTERVAL;
+        static constexpr size_t max_depth = 32;
+        static constexpr size_t bucket_heads = 4096;
+
+        struct Bucket {
+            Bucket * next;
+            size_t hash;
+            size_t depth;
+            void * frames[max_depth];
+            size_t live_count;
+            size_t live_bytes;
+            size_t alloc_count;
+            size_t alloc_bytes;
+        };
 
-    auto s = singleton.mutex.scoped();
+        SA____STACK_ALLOCATOR__REF_ONLY(HEAP_PROFILER, HEAP_PROFILER);
 
-    if (singleton.mutex.lock_count() != 1) {
-        return singleton.mallocator.alloc(size);
-    }
+        // the fast path, true when this allocation must be handed to sample
+        static bool should_sample(size_t size) {
+            if constexpr (interval == 0) {
+                return false;
+            } else {
+                size_t & left = countdown();
+                if (size < left) {
+                    left -= size;
+                    return false;
+                }
+                return true;
+            }
+        }
 
-    if (SA::log) {
-        SA::Logib();
-        printf("new(%zu)\n", size);
-        SA::Logr();
-    }
-    return SA::GET_GLOBAL()->alloc(size);
-}
+        // the calling thread's stack is the first frame we keep
+        SA____STACK_ALLOCATOR__NOINLINE void sample(void * ptr, size_t size) {
+            size_t & left = countdown();
+            if (!armed()) {
+                // the first allocation of a thread only starts its countdown
+                armed() = true;
+                left = next_interval();
+                if (size < left) {
+                    left -= size;
+                    return;
+                }
+            }
+            left = next_interval();
+            void * frames[max_depth + 1];
+            int depth = 0;
+#ifdef SA____STACK_ALLOCATOR__BACKTRACE
+            depth = backtrace(frames, max_depth + 1);
+#endif
+            // drop our own frame
+            size_t kept = depth > 0 ? static_cast<size_t>(depth) - 1 : 0;
+            bool watched = TrackedAllocator::watch_free<&freed>(ptr);
+            std::lock_guard<std::mutex> guard(mutex);
+            Bucket * b = bucket_of(frames + 1, kept);
+            if (b == nullptr) {
+                return;
+            }
+            b->alloc_count++;
+            b->alloc_bytes += size;
+            if (watched) {
+                b->live_count++;
+                b->live_bytes += size;
+                bool found;
+                live.find_or_add(ptr, found) = b;
+            }
+        }
 
-void *operator new[](size_t size) {
-    auto & singleton = SA::GET_SINGLETONS();
+        // writes the profile, returns false if the file could not be written
+        bool write(const char * path) {
+            FILE * file = fopen(path, "w");
+            if (file == nullptr) {
+                return false;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                size_t live_count = 0, live_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+                for_each_bucket([&](Bucket & b) {
+                    live_count += b.live_count;
+                    live_bytes += b.live_bytes;
+                    alloc_count += b.alloc_count;
+                    alloc_bytes += b.alloc_bytes;
+                });
+                fprintf(file, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", live_count, live_bytes, alloc_count, alloc_bytes, interval);
+                for_each_bucket([&](Bucket & b) {
+                    fprintf(file, "%zu: %zu [%zu: %zu] @", b.live_count, b.live_bytes, b.alloc_count, b.alloc_bytes);
+                    for (size_t i = 0; i < b.depth; i++) {
+                        fprintf(file, " %p", b.frames[i]);
+                    }
+                    fputc('\n', file);
+                });
+            }
+            // lets pprof symbolize the addresses
+            fprintf(file, "\nMAPPED_LIBRARIES:\n");
+            FILE * maps = fopen("/proc/self/maps", "r");
+            if (maps != nullptr) {
+                char buffer[4096];
+                size_t n;
+                while ((n = fread(buffer, 1, sizeof(buffer), maps)) != 0) {
+                    fwrite(buffer, 1, n, file);
+                }
+                fclose(maps);
+            }
+            return fclose(file) == 0;
+        }
+
+        // the stacks with live samples as the members of a JSON array, for SINGLETONS::write_report, bytes and objects are
+        // scaled up from the samples the way pprof does
+        static void write_live_sites(FILE * file) {
+            auto & profiler = GET_HEAP_PROFILER();
+            std::lock_guard<std::mutex> guard(profiler.mutex);
+            const char * separator = "\n";
+            profiler.for_each_bucket([&](Bucket & b) {
+                if (b.live_count == 0) {
+                    return;
+                }
+                double average = static_cast<double>(b.live_bytes) / static_cast<double>(b.live_count);
+                double scale = 1.0 / (1.0 - std::exp(-average / static_cast<double>(interval)));
+                fprintf(file, "%s    {\"samples\": %zu, \"objects\": %.0f, \"bytes\": %.0f, \"stack\": [", separator, b.live_count, b.live_count * scale, b.live_bytes * scale);
+                for (size_t i = 0; i < b.depth; i++) {
+                    fprintf(file, "%s\"%p\"", i == 0 ? "" : ", ", b.frames[i]);
+                }
+                fprintf(file, "]}");
+                separator = ",\n";
+            });
+        }
 
-    auto s = singleton.mutex.scoped();
+        // writes to SA_STACK_ALLOCATOR_HEAP_PROFILE if it is set
+        void write_at_exit() {
+            const char * path = getenv("SA_STACK_ALLOCATOR_HEAP_PROFILE");
+            if (path != nullptr) {
+                write(path);
+            }
+        }
 
-    if (singleton.mutex.lock_count() != 1) {
-        return singleton.mallocator.alloc(size);
-    }
-    if (SA::log) {
-        SA::Logib();
-        printf("new[](%zu)\n", size);
-        SA::Logr();
+        private:
+
+        std::mutex mutex;
+        Bucket * heads[bucket_heads] = {};
+        // live samples and their bucket
+        SINGLETONS::SA__PointerMap<Bucket*> live;
+
+        static size_t & countdown() {
+            static thread_local size_t left = 0;
+            return left;
+        }
+
+        static bool & armed() {
+            static thread_local bool armed = false;
+            return armed;
+        }
+
+        // exponentially distributed around interval, xorshift seeded from the thread's own address
+        static size_t next_interval() {
+            static thread_local uint64_t state = 0;
+            if (state == 0) {
+                state = reinterpret_cast<uintptr_t>(&state) ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^ 0x9E3779B97F4A7C15ULL;
+            }
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            // 53 random bits, never 0 so the log is finite
+            double u = (static_cast<double>(state >> 11) + 1.0) / 9007199254740993.0;
+            double d = -std::log(u) * static_cast<double>(interval);
+            return d < 1.0 ? 1 : static_cast<size_t>(d);
+        }
+
+        static void freed(void * ptr, size_t size) {
+            GET_HEAP_PROFILER().remove(ptr, size);
+        }
+
+        void remove(void * ptr, size_t size) {
+            std::lock_guard<std::mutex> guard(mutex);
+            Bucket ** b = live.find(ptr);
+            if (b != nullptr) {
+                (*b)->live_count--;
+                (*b)->live_bytes -= size;
+                live.remove(ptr);
+            }
+        }
+
+        // the caller holds mutex
+        Bucket * bucket_of(void * const * frames, size_t depth) {
+            size_t h = depth;
+            for (size_t i = 0; i < depth; i++) {
+                h = (h ^ reinterpret_cast<uintptr_t>(frames[i])) * 0x100000001B3ULL;
+            }
+            Bucket *& head = heads[(h ^ (h >> 29)) & (bucket_heads - 1)];
+            for (Bucket * b = head; b != nullptr; b = b->next) {
+                if (b->hash == h && b->depth == depth && memcmp(b->frames, frames, depth * sizeof(void*)) == 0) {
+                    return b;
+                }
+            }
+            // never freed, the profile describes the whole run
+            Bucket * b = static_cast<Bucket*>(SINGLETONS::inspect_calloc(1, sizeof(Bucket)));
+            if (b == nullptr) {
+                return nullptr;
+            }
+            b->hash = h;
+            b->depth = depth;
+            memcpy(b->frames, frames, depth * sizeof(void*));
+            b->next = head;
+            head = b;
+            return b;
+        }
+
+        template <typename F>
+        void for_each_bucket(F f) {
+            for (size_t i = 0; i < bucket_heads; i++) {
+                for (Bucket * b = heads[i]; b != nullptr; b = b->next) {
+                    f(*b);
+                }
+            }
+        }
+    };
+
+    namespace OVERRIDE {
+        // set while this thread is inside operator new, a nested request (from a new_handler or a logging hook) must
+        // not reenter the magazine it is interrupting
+        inline bool & active() {
+            static thread_local bool active = false;
+            return active;
+        }
+
+        class Scoped {
+            bool & flag;
+
+            public:
+
+            Scoped() : flag(active()) {
+                flag = true;
+            }
+
+            Scoped(const Scoped & other) = delete;
+            Scoped & operator=(const Scoped & other) = delete;
+
+            ~Scoped() {
+                flag = false;
+            }
+        };
+
+        // lock free unless a magazine has to refill from the depot, the block is owned by the global allocator through
+        // its header without entering the global header list
+        inline void * alloc(size_t size) {
+            if (active()) {
+                return GET_GLOBAL()->alloc_unlisted(size, false);
+            }
+            Scoped s;
+            void * p = GET_GLOBAL()->alloc_unlisted(size);
+            if (HEAP_PROFILER::should_sample(size)) {
+                GET_HEAP_PROFILER().sample(p, size);
+            }
+            return p;
+        }
+
+        inline void dealloc(void * ptr) {
+            GET_GLOBAL()->dealloc(ptr);
+        }
+
+#ifdef __cpp_aligned_new
+        // the header path only guarantees alignof(std::max_align_t), stricter requests bypass the allocator entirely
+        inline bool over_aligned(std::align_val_t al) {
+            return static_cast<size_t>(al) > alignof(std::max_align_t);
+        }
+
+        inline void * alloc_aligned(size_t size, std::align_val_t al) {
+            if (!over_aligned(al)) {
+                return alloc(size);
+            }
+            while (true) {
+                void * p = SINGLETONS::inspect_aligned_calloc(static_cast<size_t>(al), size);
+                if (p != nullptr) {
+                    return p;
+                }
+                auto handler = std::get_new_handler();
+                if (handler == nullptr) {
+                    throw std::bad_alloc();
+                }
+                handler();
+            }
+        }
+
+        inline void dealloc_aligned(void * ptr, std::align_val_t al) {
+            if (!over_aligned(al)) {
+                dealloc(ptr);
+                return;
+            }
+            SINGLETONS::inspect_free(ptr);
+        }
+#endif
     }
-    return SA::GET_GLOBAL()->alloc(size);
+}
+
+void *operator new(size_t size) {
+    void * p = SA::OVERRIDE::alloc(size);
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::NEW, p, size);
+    return p;
+}
+
+void *operator new[](size_t size) {
+    void * p = SA::OVERRIDE::alloc(size);
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::NEW_ARRAY, p, size);
+    return p;
 }
 
 void operator delete(void *ptr) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("delete(%p)\n", ptr);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::DELETE, ptr);
+    SA::OVERRIDE::dealloc(ptr);
 }
 
 void operator delete[](void *ptr) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("delete[](%p)\n", ptr);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::DELETE_ARRAY, ptr);
+    SA::OVERRIDE::dealloc(ptr);
 }
 
 void operator delete(void *ptr, std::size_t sz) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("delete(%p, %zu)\n", ptr, sz);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::DELETE, ptr, sz);
+    SA::OVERRIDE::dealloc(ptr);
 }
 
 void operator delete[](void *ptr, std::size_t sz) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("delete[](%p, %zu)\n", ptr, sz);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::DELETE_ARRAY, ptr, sz);
+    SA::OVERRIDE::dealloc(ptr);
 }
 
 #ifdef __cpp_aligned_new
 void *operator new(size_t size, std::align_val_t al) {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("aligned new(%zu, %zu)\n", size, al);
-        SA::Logr();
-    }
-    void * p = SA::GET_GLOBAL()->alloc(size);
-    singleton.mutex.unlock();
+    void * p = SA::OVERRIDE::alloc_aligned(size, al);
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::ALIGNED_NEW, p, size, static_cast<uint64_t>(al));
     return p;
 }
 
 void *operator new[](std::size_t size, std::align_val_t al) {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("aligned new[](%zu, %zu)\n", size, al);
-        SA::Logr();
-    }
-    void * p = SA::GET_GLOBAL()->alloc(size);
-    singleton.mutex.unlock();
+    void * p = SA::OVERRIDE::alloc_aligned(size, al);
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::ALIGNED_NEW_ARRAY, p, size, static_cast<uint64_t>(al));
     return p;
 }
 
 void operator delete(void *ptr, std::align_val_t al) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("aligned delete(%p, %zu)\n", ptr, al);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::ALIGNED_DELETE, ptr, 0, static_cast<uint64_t>(al));
+    SA::OVERRIDE::dealloc_aligned(ptr, al);
 }
 
 void operator delete[](void *ptr, std::align_val_t al) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("aligned delete[](%p, %zu)\n", ptr, al);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::ALIGNED_DELETE_ARRAY, ptr, 0, static_cast<uint64_t>(al));
+    SA::OVERRIDE::dealloc_aligned(ptr, al);
 }
 
 void operator delete(void *ptr, std::size_t sz, std::align_val_t al) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("aligned delete(%p, %zu, %zu)\n", ptr, sz, al);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::ALIGNED_DELETE, ptr, sz, static_cast<uint64_t>(al));
+    SA::OVERRIDE::dealloc_aligned(ptr, al);
 }
 
 void operator delete[](void *ptr, std::size_t sz, std::align_val_t al) noexcept {
-    auto & singleton = SA::GET_SINGLETONS();
-    singleton.mutex.lock();
-    if (SA::log) {
-        SA::Logib();
-        printf("aligned delete[](%p, %zu, %zu)\n", ptr, sz, al);
-        SA::Logr();
-    }
-    SA::GET_GLOBAL()->dealloc(ptr);
-    singleton.mutex.unlock();
+    SA____STACK_ALLOCATOR__EVENT(SA::EVENT::ALIGNED_DELETE_ARRAY, ptr, sz, static_cast<uint64_t>(al));
+    SA::OVERRIDE::dealloc_aligned(ptr, al);
 }
 #endif
 
@@ -0,0 +1,63 @@
+#include <SA.h>
+#include <chrono>
+#include <thread>
+
+// measures plain new/delete throughput as the number of threads grows
+//
+// bench_new links against StackAllocatorOverride and bench_new_native against StackAllocator, the same loop is timed
+// against the operator new override and against the default operator new
+//
+// usage: bench_new [max threads, defaults to 32] [new/delete pairs per thread, defaults to 200000]
+
+struct Node {
+    Node * next;
+    size_t value[5];
+};
+
+int main(int argc, char ** argv) {
+    size_t max_threads = 32;
+    size_t ops = 200000;
+    if (argc > 1) {
+        max_threads = strtoull(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        ops = strtoull(argv[2], nullptr, 10);
+    }
+
+#ifdef SA_STACK_ALLOCATOR__SA_OVERRIDE_NEW
+    printf("operator new override\n");
+#else
+    printf("default operator new\n");
+#endif
+    printf("%8s %16s %16s\n", "threads", "Mops/s", "ns/op/thread");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([ops]() {
+                // keep a small working set alive, mixing object and array sizes
+                Node * live[64] = {};
+                int * arrays[64] = {};
+                for (size_t i = 0; i < ops; i++) {
+                    size_t slot = i & 63;
+                    delete live[slot];
+                    delete[] arrays[slot];
+                    live[slot] = new Node();
+                    arrays[slot] = new int[1 + (i & 31)];
+                }
+                for (size_t slot = 0; slot < 64; slot++) {
+                    delete live[slot];
+                    delete[] arrays[slot];
+                }
+            });
+        }
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double total = static_cast<double>(threads * ops * 2);
+        printf("%8zu %16.2f %16.1f\n", threads, total / seconds / 1e6, seconds * 1e9 / (ops * 2));
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <SA.h>
+#include <chrono>
+
+// measures the per operation cost of the pointer registry as the number of live tracked pointers grows
+//
+// scope teardown is the cost of destroying a short lived allocator holding 100 objects while the other pointers are
+// alive, the scope finds its objects through their headers (or its own heap with SA_STACK_ALLOCATOR_ALLOC_HOOK) and
+// should not depend on the live count, adopted teardown is the same for a scope that adopted its 100 objects, which
+// it finds through its own set of registry records
+//
+// batched adopt+release is the same pair through adopt_many and release_many in batches of 1000 pointers
+//
+// move is the cost of moving the allocator holding every live pointer out and back, which only hands its owner handle
+// over and should not depend on the live count either, splice is the cost of handing a scope of 100 objects to that
+// allocator, which rebinds the scope's handle and concatenates the header lists without visiting an object
+//
+// metadata is the registry bookkeeping per tracked pointer, the index table itself is not included, reserved is the
+// size of the node pool chunks the records are carved from per tracked pointer
+//
+// usage: bench_registry [max live pointers, defaults to 10000000]
+
+static void noop(void*) {}
+
+int main(int argc, char ** argv) {
+    size_t max_live = 10000000;
+    if (argc > 1) {
+        max_live = strtoull(argv[1], nullptr, 10);
+    }
+    const size_t ops = 200000;
+
+    const size_t batch = 1000;
+    void * batch_pointers[batch];
+
+    printf("%12s %16s %16s %16s %16s %16s %16s %16s %16s %16s %16s\n", "live", "metadata", "reserved", "adopt+release", "batched", "alloc+dealloc", "scope teardown", "adopted teardown", "move", "splice", "dealloc_all");
+    for (size_t live = 10; live <= max_live; live *= 10) {
+        // fake but unique addresses, they are never dereferenced since the destructor is a no-op
+        uint8_t * base = static_cast<uint8_t*>(calloc(live + ops, 1));
+        double metadata_bytes;
+        double reserved_bytes;
+        double adopt_release_ns;
+        double batched_ns;
+        double alloc_dealloc_ns;
+        double scope_teardown_ns;
+        double adopted_teardown_ns;
+        double move_ns;
+        double splice_ns;
+        double dealloc_all_ns;
+        {
+            SA::Allocator a;
+            for (size_t i = 0; i < live; i++) {
+                a.adopt(base + i, noop);
+            }
+            auto & singleton = SA::GET_SINGLETONS();
+            metadata_bytes = static_cast<double>(singleton.metadata_usage.load()) / singleton.tracked_objects.load();
+            reserved_bytes = static_cast<double>(singleton.metadata_reserved.load()) / singleton.tracked_objects.load();
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < ops; i++) {
+                a.adopt(base + live + i, noop);
+                a.release(base + live + i);
+            }
+            auto end = std::chrono::steady_clock::now();
+            adopt_release_ns = std::chrono::duration<double, std::nano>(end - start).count() / ops;
+
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < ops; i += batch) {
+                for (size_t j = 0; j < batch; j++) {
+                    batch_pointers[j] = base + live + i + j;
+                }
+                a.adopt_many(batch_pointers, batch, noop);
+                a.release_many(batch_pointers, batch);
+            }
+            end = std::chrono::steady_clock::now();
+            batched_ns = std::chrono::duration<double, std::nano>(end - start).count() / ops;
+
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < ops; i++) {
+                a.dealloc(a.alloc<int>(static_cast<int>(i)));
+            }
+            end = std::chrono::steady_clock::now();
+            alloc_dealloc_ns = std::chrono::duration<double, std::nano>(end - start).count() / ops;
+
+            const size_t scopes = 10;
+            scope_teardown_ns = 0;
+            for (size_t i = 0; i < scopes; i++) {
+                SA::Allocator * scope = new SA::Allocator(true);
+                for (int j = 0; j < 100; j++) {
+                    (void) scope->alloc<int>(j);
+                }
+                start = std::chrono::steady_clock::now();
+                delete scope;
+                end = std::chrono::steady_clock::now();
+                scope_teardown_ns += std::chrono::duration<double, std::nano>(end - start).count() / scopes;
+            }
+
+            adopted_teardown_ns = 0;
+            for (size_t i = 0; i < scopes; i++) {
+                SA::Allocator * scope = new SA::Allocator();
+                for (int j = 0; j < 100; j++) {
+                    scope->adopt(new int(j));
+                }
+                start = std::chrono::steady_clock::now();
+                delete scope;
+                end = std::chrono::steady_clock::now();
+                adopted_teardown_ns += std::chrono::duration<double, std::nano>(end - start).count() / scopes;
+            }
+
+            const size_t moves = 1000;
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < moves; i++) {
+                SA::Allocator moved(std::move(a));
+                a = std::move(moved);
+            }
+            end = std::chrono::steady_clock::now();
+            move_ns = std::chrono::duration<double, std::nano>(end - start).count() / moves;
+
+            splice_ns = 0;
+            for (size_t i = 0; i < scopes; i++) {
+                SA::Allocator scope;
+                for (int j = 0; j < 100; j++) {
+                    (void) scope.alloc<int>(j);
+                }
+                start = std::chrono::steady_clock::now();
+                a.splice(scope);
+                end = std::chrono::steady_clock::now();
+                splice_ns += std::chrono::duration<double, std::nano>(end - start).count() / scopes;
+            }
+
+            start = std::chrono::steady_clock::now();
+            a.dealloc_all();
+            end = std::chrono::steady_clock::now();
+            dealloc_all_ns = std::chrono::duration<double, std::nano>(end - start).count() / live;
+        }
+        free(base);
+        printf("%12zu %10.1f bytes %10.1f bytes %13.1f ns %13.1f ns %13.1f ns %13.1f ns %13.1f ns %13.1f ns %13.1f ns %13.1f ns\n", live, metadata_bytes, reserved_bytes, adopt_release_ns, batched_ns, alloc_dealloc_ns, scope_teardown_ns, adopted_teardown_ns, move_ns, splice_ns, dealloc_all_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <SA.h>
+#include <chrono>
+#include <list>
+#include <map>
+
+// measures node based container churn with the standard allocator, the stateless SA::Mallocator and a
+// SA::ScopedStdAllocator bound to a scope
+//
+// usage: bench_stl [elements, defaults to 100000]
+
+template <typename Alloc>
+static double run(Alloc alloc, size_t elements) {
+    using Pair = typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<const size_t, size_t>>;
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::map<size_t, size_t, std::less<size_t>, Pair> m(alloc);
+        std::list<size_t, Alloc> l(alloc);
+        for (size_t i = 0; i < elements; i++) {
+            m.emplace(i, i);
+            l.push_back(i);
+        }
+        for (size_t i = 0; i < elements; i += 2) {
+            m.erase(i);
+            l.pop_front();
+        }
+        for (size_t i = 0; i < elements; i += 2) {
+            m.emplace(i, i);
+            l.push_back(i);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    // every element is inserted once and half of them are erased and inserted again
+    return std::chrono::duration<double, std::nano>(end - start).count() / (elements * 2);
+}
+
+int main(int argc, char ** argv) {
+    size_t elements = 100000;
+    if (argc > 1) {
+        elements = strtoull(argv[1], nullptr, 10);
+    }
+
+    printf("%26s %16s\n", "allocator", "ns/op");
+    printf("%26s %13.1f ns\n", "std::allocator", run(std::allocator<size_t>(), elements));
+    printf("%26s %13.1f ns\n", "SA::Mallocator", run(SA::Mallocator<size_t>(), elements));
+    {
+        SA::Allocator a;
+        printf("%26s %13.1f ns\n", "ScopedStdAllocator", run(SA::ScopedStdAllocator<size_t>(a), elements));
+    }
+    {
+        SA::LocalAllocator a;
+        printf("%26s %13.1f ns\n", "ScopedStdAllocator local", run(SA::ScopedStdAllocator<size_t, SA::LocalAllocator>(a), elements));
+    }
+    {
+        SA::RegionAllocator r;
+        printf("%26s %13.1f ns\n", "ScopedStdAllocator region", run(SA::ScopedStdAllocator<size_t, SA::RegionAllocator>(r), elements));
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <SA.h>
+#include <chrono>
+#include <string>
+
+// measures how long the end of a scope holding many objects blocks the thread that ends it
+//
+// inline runs every destructor in the allocator destructor, background and incremental only hand the objects over, the
+// lag is the time the reclamation thread took to destroy the background batch after it was handed over
+//
+// usage: bench_teardown [max objects per scope, defaults to 1000000]
+
+template <typename F>
+static double time_ms(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void fill(SA::Allocator & a, size_t objects) {
+    for (size_t i = 0; i < objects; i++) {
+        (void) a.alloc<std::string>(64, 'x');
+    }
+}
+
+int main(int argc, char ** argv) {
+    size_t max_objects = 1000000;
+    if (argc > 1) {
+        max_objects = strtoull(argv[1], nullptr, 10);
+    }
+    auto & reclaimer = SA::GET_RECLAIMER();
+
+    printf("%12s %16s %16s %16s %16s\n", "objects", "inline", "background", "incremental", "background lag");
+    for (size_t objects = 1000; objects <= max_objects; objects *= 10) {
+        SA::Allocator * a = new SA::Allocator();
+        fill(*a, objects);
+        double inline_ms = time_ms([&]() { delete a; });
+
+        a = new SA::Allocator();
+        a->set_teardown(SA::Teardown::Background);
+        fill(*a, objects);
+        double background_ms = time_ms([&]() { delete a; });
+        while (reclaimer.stats().queued_batches != 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        double lag_ms = std::chrono::duration<double, std::milli>(reclaimer.stats().last_lag).count();
+
+        a = new SA::Allocator();
+        a->set_teardown(SA::Teardown::Incremental);
+        fill(*a, objects);
+        double incremental_ms = time_ms([&]() { delete a; });
+        // what an idle loop would do, a millisecond at a time
+        while (reclaimer.stats().queued_objects != 0) {
+            reclaimer.reclaim(std::chrono::milliseconds(1));
+        }
+
+        printf("%12zu %13.3f ms %13.3f ms %13.3f ms %13.3f ms\n", objects, inline_ms, background_ms, incremental_ms, lag_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <SA.h>
+#include <chrono>
+#include <thread>
+
+// measures allocation throughput as the number of threads grows, each thread owns its own allocator
+//
+// SA::Allocator is the default policy set, SA::LocalAllocator skips locking, statistics and the secure wipe,
+// SA::AllocatorWithMemUsage additionally keeps its own usage counters
+//
+// usage: bench_threads [max threads, defaults to 32] [alloc/dealloc pairs per thread, defaults to 200000]
+
+template <typename A>
+static double run(size_t threads, size_t ops) {
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([ops]() {
+            A a;
+            // keep a small working set alive so the allocator is not empty
+            int * live[64] = {};
+            for (size_t i = 0; i < ops; i++) {
+                size_t slot = i & 63;
+                a.dealloc(live[slot]);
+                live[slot] = a.template alloc<int>(static_cast<int>(i));
+            }
+        });
+    }
+    for (auto & worker : workers) {
+        worker.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char ** argv) {
+    size_t max_threads = 32;
+    size_t ops = 200000;
+    if (argc > 1) {
+        max_threads = strtoull(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        ops = strtoull(argv[2], nullptr, 10);
+    }
+
+    printf("%8s %16s %16s %16s %16s %16s\n", "threads", "Mops/s", "ns/op/thread", "local Mops/s", "local ns/op", "usage ns/op");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double seconds = run<SA::Allocator>(threads, ops);
+        double local_seconds = run<SA::LocalAllocator>(threads, ops);
+        double usage_seconds = run<SA::AllocatorWithMemUsage>(threads, ops);
+        double total = static_cast<double>(threads * ops);
+        printf("%8zu %16.2f %16.1f %16.2f %16.1f %16.1f\n", threads, total / seconds / 1e6, seconds * 1e9 / ops, total / local_seconds / 1e6, local_seconds * 1e9 / ops, usage_seconds * 1e9 / ops);
+    }
+    SA::MemoryUsage usage = SA::GET_SINGLETONS().snapshot().global;
+    printf("peak %zu bytes, %zu bytes allocated in total\n", usage.peak, usage.total);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <SA.h>
+#include <chrono>
+
+// measures wipe throughput per block size for each WipePolicy, next to the volatile byte loop used before the policies
+//
+// usage: bench_wipe [bytes wiped per measurement, defaults to 256MB]
+
+static void byte_loop(void * p, size_t size) {
+    volatile uint8_t * b = static_cast<volatile uint8_t*>(p);
+    for (size_t i = 0; i < size; i++) {
+        b[i] = 0;
+    }
+}
+
+template <typename F>
+static double run(F wipe, uint8_t * buffer, size_t block, size_t total) {
+    size_t rounds = total / block;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        wipe(buffer, block);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(rounds * block) / std::chrono::duration<double>(end - start).count() / 1e9;
+}
+
+int main(int argc, char ** argv) {
+    size_t total = 256 * 1024 * 1024;
+    if (argc > 1) {
+        total = strtoull(argv[1], nullptr, 10);
+    }
+    const size_t max_block = 1024 * 1024;
+    uint8_t * buffer = static_cast<uint8_t*>(calloc(1, max_block));
+
+    printf("%10s %16s %16s %16s %16s\n", "block", "byte loop", "NoWipe", "FastWipe", "ParanoidWipe");
+    for (size_t block = 16; block <= max_block; block *= 4) {
+        double bytes = run(byte_loop, buffer, block, total);
+        double none = run(SA::NoWipe::zero, buffer, block, total);
+        double fast = run(SA::FastWipe::zero, buffer, block, total);
+        double paranoid = run(SA::ParanoidWipe::zero, buffer, block, total);
+        printf("%10zu %11.2f GB/s %11.2f GB/s %11.2f GB/s %11.2f GB/s\n", block, bytes, none, fast, paranoid);
+    }
+    free(buffer);
+    return 0;
+}
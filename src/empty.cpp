@@ -4,8 +4,18 @@
 #ifdef SA_STACK_ALLOCATOR__LOGGING
 #warning STACK ALLOCATOR LOGGING ENABLED
 bool SA::log = true;
-#else
-bool SA::log = false;
+
+SA::EVENT_LOG & SA::GET_EVENT_LOG() {
+    // never destroyed, threads may record while static destructors run, the drain thread is stopped instead
+    alignas(SA::EVENT_LOG) static unsigned char storage[sizeof(SA::EVENT_LOG)];
+    static SA::EVENT_LOG * event_log = new (storage) SA::EVENT_LOG();
+    static struct STOP {
+        ~STOP() {
+            event_log->stop();
+        }
+    } stop;
+    return *event_log;
+}
 #endif
 #endif
 
@@ -14,16 +24,50 @@ SA::SINGLETONS & SA::GET_SINGLETONS() {
     return global;
 }
 
+SA::RECLAIMER & SA::GET_RECLAIMER() {
+    // constructed after the singletons so it is destroyed first and runs what is still queued while they are alive
+    GET_SINGLETONS();
+    static SA::RECLAIMER reclaimer;
+    return reclaimer;
+}
+
 SA::TrackedAllocator * SA::GET_GLOBAL() {
     // ensure singleton is initialized
     GET_SINGLETONS();
 #ifdef SA_STACK_ALLOCATOR__SA_OVERRIDE_NEW
-    static SA::TrackedAllocator global;
-    return &global;
+    static SA::TrackedAllocator * global = [] {
+        static SA::TrackedAllocator allocator;
+        // kept first among the owners of a pointer, see PTR_OWNERS
+        allocator.owner_handle()->global = true;
+        GET_SINGLETONS().global_owner = allocator.owner_handle();
+        return &allocator;
+    }();
+    return global;
 #else
     return nullptr;
 #endif
 }
+#ifdef SA_STACK_ALLOCATOR__SA_OVERRIDE_NEW
+SA::HEAP_PROFILER & SA::GET_HEAP_PROFILER() {
+    // never destroyed, operator new and delete keep running while static destructors run, the profile is written
+    // instead
+    GET_SINGLETONS();
+    alignas(SA::HEAP_PROFILER) static unsigned char storage[sizeof(SA::HEAP_PROFILER)];
+    static SA::HEAP_PROFILER * profiler = [] {
+        SA::HEAP_PROFILER * p = new (storage) SA::HEAP_PROFILER();
+        // the shutdown report lists the live allocation sites
+        GET_SINGLETONS().report_sites = &SA::HEAP_PROFILER::write_live_sites;
+        return p;
+    }();
+    static struct WRITE {
+        ~WRITE() {
+            profiler->write_at_exit();
+        }
+    } write;
+    return *profiler;
+}
+#endif
+
 bool SA::IS_GLOBAL(SA::AllocatorBase * allocator) {
     return allocator == GET_GLOBAL();
 }
\ No newline at end of file
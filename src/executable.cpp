@@ -132,6 +132,22 @@ int main () {
         a.release(i5);
         delete i5;
     }
+    if (true) {
+        SA::RegionAllocator r;
+
+        // carved from the region with a bump pointer, destroyed in LIFO order at end of scope
+        auto * v1 = r.alloc<V>(1);
+        auto * v2 = r.alloc<V>(2);
+
+        // trivially destructible, no destructor is recorded
+        auto * i7 = r.alloc<int>(7);
+
+        // i8 will be deleted by 'r'
+        r.adopt(new int(8));
+
+        auto * chars = r.allocArray<char>(64);
+        chars[0] = 'a';
+    }
     printf("end main\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,819 @@
+#include <SA.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// behaviour checks for the paths the benches only time, prints every failed check and exits non zero if any failed
+//
+// usage: sa_check
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+// counts the live instances so a check can tell whether a destructor ran
+struct Counted {
+    static int live;
+    int value;
+    Counted(int value = 0) : value(value) { live++; }
+    Counted(const Counted & other) : value(other.value) { live++; }
+    ~Counted() { live--; }
+};
+
+int Counted::live = 0;
+
+static void check_pointer_map() {
+    using Map = SA::SINGLETONS::SA__PointerMap<size_t>;
+    auto key = [](size_t i) { return reinterpret_cast<void*>((i + 1) * 16); };
+    // a cluster of keys sharing the last home slot of a 16 slot table and keys homed at its start, so the probes wrap
+    std::vector<void*> cluster;
+    for (size_t i = 0, last = 0, first = 0; last < 4 || first < 2; i++) {
+        size_t home = Map::hash(key(i)) & 15;
+        if (home == 15 && last < 4) {
+            cluster.push_back(key(i));
+            last++;
+        } else if (home == 0 && first < 2) {
+            cluster.push_back(key(i));
+            first++;
+        }
+    }
+    // removing any one of them leaves every other reachable
+    for (size_t removed = 0; removed < cluster.size(); removed++) {
+        Map map;
+        bool found;
+        for (size_t i = 0; i < cluster.size(); i++) {
+            map.find_or_add(cluster[i], found) = i;
+        }
+        CHECK(map.capacity == 16);
+        CHECK(map.remove(cluster[removed]));
+        CHECK(!map.remove(cluster[removed]));
+        CHECK(map.find(cluster[removed]) == nullptr);
+        for (size_t i = 0; i < cluster.size(); i++) {
+            if (i != removed) {
+                size_t * value = map.find(cluster[i]);
+                CHECK(value != nullptr && *value == i);
+            }
+        }
+        CHECK(map.size == cluster.size() - 1);
+    }
+    // random inserts and removes against std::map, the table grows and shrinks its clusters all along
+    Map map;
+    std::map<void*, size_t> reference;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    bool mismatch = false;
+    for (size_t step = 0; step < 20000; step++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        void * k = key((state >> 33) % 512);
+        if ((state >> 20) & 1) {
+            bool found;
+            map.find_or_add(k, found) = step;
+            mismatch |= found != (reference.count(k) != 0);
+            reference[k] = step;
+        } else {
+            mismatch |= map.remove(k) != (reference.erase(k) != 0);
+        }
+    }
+    for (size_t i = 0; i < 512; i++) {
+        size_t * value = map.find(key(i));
+        auto it = reference.find(key(i));
+        mismatch |= (value == nullptr) != (it == reference.end()) || (value != nullptr && *value != it->second);
+    }
+    CHECK(!mismatch);
+    CHECK(map.size == reference.size());
+}
+
+static size_t registry_records() {
+    size_t records = 0;
+    SA::GET_SINGLETONS().tracked_pointers.visit([&](SA::SINGLETONS::PointerInfo &) { records++; });
+    return records;
+}
+
+static void check_registry() {
+    size_t before = registry_records();
+    SA::Allocator a;
+    std::vector<Counted*> adopted;
+    size_t shards[SA::SINGLETONS::SA__Sharded<SA::SINGLETONS::PTRINFO_INDEX>::shard_count] = {};
+    for (int i = 0; i < 1000; i++) {
+        adopted.push_back(new Counted(i));
+        a.adopt(adopted.back());
+        shards[SA::SINGLETONS::SA__Sharded<SA::SINGLETONS::PTRINFO_INDEX>::shard_index(adopted.back())]++;
+    }
+    CHECK(registry_records() == before + 1000);
+    // the pointers spread over the shards
+    size_t used = 0;
+    for (size_t count : shards) {
+        used += count != 0;
+    }
+    CHECK(used == sizeof(shards) / sizeof(shards[0]) || used > 1);
+    for (int i = 0; i < 500; i++) {
+        a.dealloc(adopted[i]);
+    }
+    CHECK(registry_records() == before + 500);
+    CHECK(Counted::live == 500);
+    a.dealloc_all();
+    CHECK(registry_records() == before);
+    CHECK(Counted::live == 0);
+}
+
+static std::vector<int> destroyed;
+
+struct Ordered {
+    int id;
+    Ordered(int id) : id(id) {}
+    ~Ordered() { destroyed.push_back(id); }
+};
+
+static void check_region() {
+    destroyed.clear();
+    {
+        // small chunks so the objects span many of them
+        SA::RegionAllocator region(64);
+        for (int i = 0; i < 100; i++) {
+            (void) region.alloc<Ordered>(i);
+        }
+        for (size_t alignment = 1; alignment <= 4096; alignment *= 2) {
+            void * p = region.alloc(3, alignment);
+            CHECK(reinterpret_cast<uintptr_t>(p) % alignment == 0);
+        }
+        struct alignas(128) Wide {
+            char c;
+        };
+        CHECK(reinterpret_cast<uintptr_t>(region.alloc<Wide>()) % 128 == 0);
+        int * array = region.allocArray<int>(100);
+        bool zeroed = true;
+        for (int i = 0; i < 100; i++) {
+            zeroed &= array[i] == 0;
+        }
+        CHECK(zeroed);
+        region.adopt(new Ordered(100));
+        CHECK(destroyed.empty());
+        region.dealloc_all();
+        CHECK(destroyed.size() == 101);
+        bool lifo = true;
+        for (size_t i = 0; i < destroyed.size(); i++) {
+            lifo &= destroyed[i] == static_cast<int>(100 - i);
+        }
+        CHECK(lifo);
+        // usable again, the destructor finishes what is left
+        (void) region.alloc<Ordered>(101);
+    }
+    CHECK(destroyed.size() == 102 && destroyed.back() == 101);
+}
+
+static int plain_deleted = 0;
+
+static void check_deleters() {
+    auto & singleton = SA::GET_SINGLETONS();
+    size_t metadata = singleton.metadata_usage.load();
+    int bound_deleted = 0;
+    {
+        SA::Allocator a;
+        a.adopt(new Counted(1));
+        a.adopt(new Counted(2), [](void * p) { plain_deleted++; delete static_cast<Counted*>(p); });
+        a.adopt(new Counted(3), [&bound_deleted](void * p) { bound_deleted++; delete static_cast<Counted*>(p); });
+        a.adopt(new int(4));
+        CHECK(Counted::live == 3);
+        CHECK(registry_records() >= 4);
+    }
+    CHECK(Counted::live == 0);
+    CHECK(plain_deleted == 1);
+    CHECK(bound_deleted == 1);
+    // the records and the bound deleter are given back
+    CHECK(singleton.metadata_usage.load() == metadata);
+}
+
+static void check_owners() {
+    auto & singleton = SA::GET_SINGLETONS();
+    size_t metadata = singleton.metadata_usage.load();
+    SA::Allocator owners[5];
+    // past the two inline slots the owners spill to an array, the object lives until the last one lets go
+    Counted * p = new Counted(1);
+    for (auto & owner : owners) {
+        owner.adopt(p);
+    }
+    size_t refs = 0;
+    singleton.tracked_pointers.visit([&](SA::SINGLETONS::PointerInfo & info) {
+        if (info.pointer == p) {
+            refs = info.refs.size;
+        }
+    });
+    CHECK(refs == 5);
+    for (int i = 0; i < 4; i++) {
+        owners[i].dealloc(p);
+        CHECK(Counted::live == 1);
+    }
+    owners[4].dealloc(p);
+    CHECK(Counted::live == 0);
+    // a header allocation shared four ways
+    Counted * q = owners[0].alloc<Counted>(2);
+    for (int i = 1; i < 4; i++) {
+        owners[i].adopt(q);
+    }
+    owners[0].dealloc_all();
+    owners[2].dealloc(q);
+    owners[1].dealloc_all();
+    CHECK(Counted::live == 1);
+    owners[3].dealloc(q);
+    CHECK(Counted::live == 0);
+    // release drops every owner at once
+    Counted * r = new Counted(3);
+    for (auto & owner : owners) {
+        owner.adopt(r);
+    }
+    SA::Allocator::release(r);
+    for (auto & owner : owners) {
+        owner.dealloc_all();
+    }
+    CHECK(Counted::live == 1);
+    delete r;
+    CHECK(singleton.metadata_usage.load() == metadata);
+}
+
+template <typename W>
+static bool zeroes() {
+    unsigned char buffer[67];
+    memset(buffer, 0xAB, sizeof(buffer));
+    W::zero(buffer + 1, 65);
+    bool zero = buffer[0] == 0xAB && buffer[66] == 0xAB;
+    for (size_t i = 1; i < 66; i++) {
+        zero &= buffer[i] == 0;
+    }
+    return zero;
+}
+
+// whatever the policy, blocks come back zeroed, including the ones a magazine recycled
+template <typename B, typename W>
+static bool hands_out_zeroed() {
+    SA::BasicAllocator<SA::MutexLock, SA::TypeStats, B, W> a;
+    bool zero = true;
+    for (int i = 0; i < 200; i++) {
+        unsigned char * p = static_cast<unsigned char*>(a.alloc(48));
+        for (size_t j = 0; j < 48; j++) {
+            zero &= p[j] == 0;
+        }
+        memset(p, 0xCD, 48);
+        a.dealloc(p);
+    }
+    return zero;
+}
+
+static void check_wipe() {
+    CHECK(!SA::NoWipe::wipes && SA::FastWipe::wipes && SA::ParanoidWipe::wipes);
+    CHECK(zeroes<SA::NoWipe>());
+    CHECK(zeroes<SA::FastWipe>());
+    CHECK(zeroes<SA::ParanoidWipe>());
+    CHECK((hands_out_zeroed<SA::MagazineBacking, SA::NoWipe>()));
+    CHECK((hands_out_zeroed<SA::MagazineBacking, SA::FastWipe>()));
+    CHECK((hands_out_zeroed<SA::MagazineBacking, SA::ParanoidWipe>()));
+    CHECK((hands_out_zeroed<SA::CallocBacking, SA::ParanoidWipe>()));
+    {
+        SA::LocalAllocator a;
+        for (int i = 0; i < 100; i++) {
+            (void) a.alloc<Counted>(i);
+        }
+        CHECK(Counted::live == 100);
+    }
+    CHECK(Counted::live == 0);
+}
+
+// the batched forms against one call per pointer, the same objects survive every step
+static std::vector<size_t> ownership_steps(bool batched) {
+    std::vector<size_t> steps;
+    size_t before = registry_records();
+    SA::Allocator source;
+    SA::Allocator first;
+    SA::Allocator second;
+    Counted * items[64];
+    for (int i = 0; i < 64; i++) {
+        items[i] = i == 5 ? nullptr : i % 3 == 0 ? source.alloc<Counted>(i) : new Counted(i);
+    }
+    Counted * released[8];
+    for (int i = 0; i < 8; i++) {
+        released[i] = new Counted(-i);
+    }
+    if (batched) {
+        first.adopt_many(items, 64);
+        second.adopt_many(items, 64);
+        first.adopt_many(released, 8);
+    } else {
+        for (Counted * item : items) {
+            if (item != nullptr) {
+                first.adopt(item);
+                second.adopt(item);
+            }
+        }
+        for (Counted * item : released) {
+            first.adopt(item);
+        }
+    }
+    steps.push_back(registry_records() - before);
+    if (batched) {
+        SA::Allocator::release_many(released, 8);
+        first.dealloc_many(items, 64);
+    } else {
+        for (Counted * item : released) {
+            SA::Allocator::release(item);
+        }
+        for (Counted * item : items) {
+            first.dealloc(item);
+        }
+    }
+    steps.push_back(registry_records() - before);
+    steps.push_back(Counted::live);
+    if (batched) {
+        second.dealloc_many(items, 64);
+    } else {
+        for (Counted * item : items) {
+            second.dealloc(item);
+        }
+    }
+    steps.push_back(registry_records() - before);
+    steps.push_back(Counted::live);
+    first.dealloc_all();
+    source.dealloc_all();
+    steps.push_back(Counted::live);
+    for (Counted * item : released) {
+        delete item;
+    }
+    steps.push_back(Counted::live);
+    return steps;
+}
+
+static void check_batches() {
+    std::vector<size_t> single = ownership_steps(false);
+    std::vector<size_t> batched = ownership_steps(true);
+    CHECK(single == batched);
+    // after the second owner only the source's and the released objects are left, the released ones survive every
+    // dealloc_all
+    CHECK(single.size() == 7 && single[4] == 22 + 8 && single[5] == 8 && single[6] == 0);
+}
+
+static void check_moves() {
+    {
+        SA::Allocator a;
+        for (int i = 0; i < 10; i++) {
+            a.adopt(new Counted(i));
+            (void) a.alloc<Counted>(i);
+        }
+        SA::Allocator b(std::move(a));
+        // the moved from allocator is empty and usable
+        (void) a.alloc<Counted>(-1);
+        a.adopt(new Counted(-2));
+        a.dealloc_all();
+        CHECK(Counted::live == 20);
+        SA::Allocator c;
+        c = std::move(b);
+        b.dealloc_all();
+        CHECK(Counted::live == 20);
+        // release finds the pointer in the owned set that moved
+        Counted * kept = new Counted(99);
+        c.adopt(kept);
+        SA::Allocator::release(kept);
+        c.dealloc_all();
+        CHECK(Counted::live == 1);
+        delete kept;
+    }
+    {
+        SA::Allocator d;
+        d.adopt(new Counted(1));
+        SA::Allocator e(std::move(d));
+    }
+    CHECK(Counted::live == 0);
+}
+
+struct Measured {
+    char payload[40];
+};
+
+static void check_usage() {
+    SA::TrackedAllocatorWithMemUsage a;
+    Measured * m[10];
+    for (auto & p : m) {
+        p = a.alloc<Measured>();
+    }
+    for (int i = 0; i < 5; i++) {
+        a.dealloc(m[i]);
+    }
+    (void) a.alloc<Measured>();
+    (void) a.alloc<Measured>();
+    SA::MemoryUsage u = a.memory_usage();
+    CHECK(u.current == 7 * sizeof(Measured));
+    CHECK(u.peak == 10 * sizeof(Measured));
+    CHECK(u.total == 12 * sizeof(Measured));
+    {
+        SA::MemorySnapshot s = SA::GET_SINGLETONS().snapshot();
+        CHECK(s.global.current >= u.current && s.global.peak >= s.global.current && s.global.total >= s.global.current);
+        bool listed = false;
+        for (size_t i = 0; i < s.allocator_count; i++) {
+            if (s.allocators[i].allocator == &a) {
+                listed = s.allocators[i].usage.current == u.current && s.allocators[i].usage.peak == u.peak && s.allocators[i].usage.total == u.total;
+            }
+        }
+        CHECK(listed);
+        bool typed = false;
+        for (size_t i = 0; i < s.type_count; i++) {
+            if (strstr(s.types[i].name, "Measured") != nullptr) {
+                typed = s.types[i].usage.current == u.current && s.types[i].usage.total == u.total;
+            }
+        }
+        CHECK(typed);
+    }
+    a.dealloc_all();
+    u = a.memory_usage();
+    CHECK(u.current == 0 && u.peak == 10 * sizeof(Measured) && u.total == 12 * sizeof(Measured));
+}
+
+static void check_splice() {
+    // a header allocation b had shared with a, the spliced reference and a's own go together
+    {
+        SA::Allocator a;
+        {
+            SA::Allocator b;
+            Counted * p = b.alloc<Counted>(1);
+            a.adopt(p);
+            a.splice(b);
+            a.dealloc(p);
+            CHECK(Counted::live == 0);
+        }
+        CHECK(Counted::live == 0);
+    }
+    // the other way around, b's reference is folded into ours when it is rebound
+    {
+        SA::Allocator a;
+        Counted * p = a.alloc<Counted>(1);
+        {
+            SA::Allocator b;
+            b.adopt(p);
+            a.splice(b);
+        }
+        CHECK(Counted::live == 1);
+        a.dealloc(p);
+        CHECK(Counted::live == 0);
+    }
+    // headers, adopted pointers and pointers shared with a third allocator all follow, b stays usable
+    {
+        SA::Allocator a;
+        SA::Allocator c;
+        Counted * shared;
+        Counted * adopted;
+        {
+            SA::Allocator b;
+            for (int i = 0; i < 100; i++) {
+                (void) b.alloc<Counted>(i);
+            }
+            shared = b.alloc<Counted>(-1);
+            c.adopt(shared);
+            adopted = new Counted(-2);
+            b.adopt(adopted);
+            a.splice(b);
+            CHECK(Counted::live == 102);
+            (void) b.alloc<Counted>(-3);
+        }
+        CHECK(Counted::live == 102);
+        a.dealloc(adopted);
+        CHECK(Counted::live == 101);
+        a.dealloc_all();
+        CHECK(Counted::live == 1);
+        c.dealloc(shared);
+        CHECK(Counted::live == 0);
+    }
+    // a long lived allocator splicing a scope per request keeps no handle once the spliced objects are gone
+    {
+        SA::Allocator a;
+        for (int request = 0; request < 1000; request++) {
+            SA::Allocator scope;
+            Counted * first = scope.alloc<Counted>(request);
+            Counted * second = scope.alloc<Counted>(request);
+            a.splice(scope);
+            a.dealloc(first);
+            a.dealloc(second);
+        }
+        CHECK(a.owner_handle()->absorbed == nullptr);
+        SA::Allocator empty;
+        a.splice(empty);
+        CHECK(a.owner_handle()->absorbed == nullptr);
+        SA::Allocator outer;
+        SA::Allocator inner;
+        (void) outer.alloc<Counted>(1);
+        (void) inner.alloc<Counted>(2);
+        outer.splice(inner);
+        a.splice(outer);
+        CHECK(a.owner_handle()->absorbed != nullptr);
+        a.dealloc_all();
+        CHECK(a.owner_handle()->absorbed == nullptr);
+        CHECK(Counted::live == 0);
+    }
+    // the usage count follows the objects
+    {
+        SA::TrackedAllocatorWithMemUsage a;
+        SA::TrackedAllocatorWithMemUsage b;
+        (void) b.alloc<Counted>(1);
+        size_t bytes = b.memory_usage().current;
+        a.splice(b);
+        CHECK(a.memory_usage().current == bytes);
+        CHECK(b.memory_usage().current == 0);
+        a.dealloc_all();
+        CHECK(a.memory_usage().current == 0);
+    }
+}
+
+static void check_teardown() {
+    {
+        SA::Allocator a;
+        (void) a.alloc<Counted>(1);
+    }
+    CHECK(Counted::live == 0);
+    // incremental teardown leaves the objects queued until someone reclaims them, whatever the allocator type
+    {
+        SA::Allocator a;
+        SA::TrackedAllocatorWithMemUsage b;
+        a.set_teardown(SA::Teardown::Incremental);
+        b.set_teardown(SA::Teardown::Incremental);
+        for (int i = 0; i < 100; i++) {
+            (void) a.alloc<Counted>(i);
+            (void) b.alloc<Counted>(i);
+        }
+    }
+    CHECK(Counted::live == 200);
+    CHECK(SA::GET_RECLAIMER().stats().queued_objects == 200);
+    CHECK(SA::GET_RECLAIMER().reclaim() == 200);
+    CHECK(Counted::live == 0);
+    CHECK(SA::GET_RECLAIMER().stats().queued_batches == 0);
+    // a background teardown is finished by the reclamation thread on its own
+    {
+        SA::TrackedAllocatorWithMemUsage a;
+        a.set_teardown(SA::Teardown::Background);
+        for (int i = 0; i < 100; i++) {
+            (void) a.alloc<Counted>(i);
+        }
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (SA::GET_RECLAIMER().stats().queued_batches != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(SA::GET_RECLAIMER().stats().queued_batches == 0);
+    CHECK(Counted::live == 0);
+}
+
+static void check_magazines() {
+    auto & magazines = SA::GET_SINGLETONS().magazines;
+    size_t before = magazines.reserved_usage.load();
+    // a burst of small objects freed again, the depot keeps at most depot_limit blocks of the class, the thread's own
+    // magazine at most a full one
+    const size_t burst = 100000;
+    auto churn = [&] {
+        SA::Allocator a;
+        Counted ** objects = new Counted*[burst];
+        for (size_t i = 0; i < burst; i++) {
+            objects[i] = a.alloc<Counted>(static_cast<int>(i));
+        }
+        CHECK(magazines.reserved_usage.load() > before + burst * sizeof(Counted));
+        for (size_t i = 0; i < burst; i++) {
+            a.dealloc(objects[i]);
+        }
+        delete[] objects;
+    };
+    // a Counted and its header take well under 128 bytes
+    size_t block = 128;
+    size_t kept = (SA::SINGLETONS::MAGAZINES::depot_limit + SA::SINGLETONS::MAGAZINES::capacity) * block;
+    churn();
+    CHECK(SA::SINGLETONS::MAGAZINES::depot_limit == 0 || magazines.reserved_usage.load() <= before + kept);
+    // a thread that exits after a burst drains into the depot, which trims on the way
+    std::thread worker(churn);
+    worker.join();
+    CHECK(SA::SINGLETONS::MAGAZINES::depot_limit == 0 || magazines.reserved_usage.load() <= before + kept);
+    magazines.trim();
+    CHECK(Counted::live == 0);
+}
+
+static void check_std_adapters() {
+    // every adapter bound to one allocator shares its node cache, nodes one container gave back serve the next
+    {
+        SA::TrackedAllocatorWithMemUsage a;
+        {
+            std::list<int, SA::ScopedStdAllocator<int, SA::TrackedAllocatorWithMemUsage>> first((SA::ScopedStdAllocator<int, SA::TrackedAllocatorWithMemUsage>(a)));
+            for (int i = 0; i < 1000; i++) {
+                first.push_back(i);
+            }
+        }
+        size_t used = a.memory_usage().current;
+        {
+            std::list<int, SA::ScopedStdAllocator<int, SA::TrackedAllocatorWithMemUsage>> second((SA::ScopedStdAllocator<int, SA::TrackedAllocatorWithMemUsage>(a)));
+            for (int i = 0; i < 1000; i++) {
+                second.push_back(i);
+            }
+        }
+        CHECK(a.memory_usage().current == used);
+        CHECK(a.std_node_cache() == a.std_node_cache());
+        a.dealloc_all();
+        CHECK(a.memory_usage().current == 0);
+        // a fresh cache after the old one went with dealloc_all
+        std::map<int, Counted, std::less<int>, SA::ScopedStdAllocator<std::pair<const int, Counted>, SA::TrackedAllocatorWithMemUsage>> map((SA::ScopedStdAllocator<std::pair<const int, Counted>, SA::TrackedAllocatorWithMemUsage>(a)));
+        for (int i = 0; i < 100; i++) {
+            map.emplace(i, i);
+        }
+        CHECK(Counted::live == 100);
+        map.clear();
+        CHECK(Counted::live == 0);
+    }
+    // a locked allocator's cache is shared by containers on different threads, each list keeps its own nodes intact
+    {
+        SA::TrackedAllocatorWithMemUsage a;
+        const int threads = 4;
+        std::atomic<int> corrupted{0};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&a, &corrupted, t] {
+                for (int round = 0; round < 20; round++) {
+                    std::list<long, SA::ScopedStdAllocator<long, SA::TrackedAllocatorWithMemUsage>> list((SA::ScopedStdAllocator<long, SA::TrackedAllocatorWithMemUsage>(a)));
+                    for (long i = 0; i < 1000; i++) {
+                        list.push_back(t * 1000 + i);
+                    }
+                    long expected = t * 1000;
+                    for (long value : list) {
+                        if (value != expected++) {
+                            corrupted++;
+                        }
+                    }
+                }
+            });
+        }
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        CHECK(corrupted == 0);
+        a.dealloc_all();
+        CHECK(a.memory_usage().current == 0);
+    }
+    {
+        SA::RegionAllocator region;
+        std::list<Counted, SA::ScopedStdAllocator<Counted, SA::RegionAllocator>> first((SA::ScopedStdAllocator<Counted, SA::RegionAllocator>(region)));
+        std::list<Counted, SA::ScopedStdAllocator<Counted, SA::RegionAllocator>> second((SA::ScopedStdAllocator<Counted, SA::RegionAllocator>(region)));
+        first.emplace_back(1);
+        second.emplace_back(2);
+        CHECK(region.std_node_cache() == region.std_node_cache());
+        CHECK(Counted::live == 2);
+    }
+    CHECK(Counted::live == 0);
+    // the memory resources, what a container did not give back goes with the allocator
+    {
+        SA::TrackedAllocatorWithMemUsage a;
+        SA::TrackedResource<SA::TrackedAllocatorWithMemUsage> resource(a);
+        {
+            std::pmr::vector<Counted> v(&resource);
+            for (int i = 0; i < 100; i++) {
+                v.emplace_back(i);
+            }
+            CHECK(Counted::live == 100);
+        }
+        CHECK(Counted::live == 0);
+        CHECK(a.memory_usage().current == 0);
+        (void) resource.allocate(64, 64);
+        CHECK(a.memory_usage().current != 0);
+        a.dealloc_all();
+        CHECK(a.memory_usage().current == 0);
+        SA::RegionAllocator region;
+        SA::RegionResource scratch(region);
+        std::pmr::vector<Counted> v(&scratch);
+        v.emplace_back(1);
+        CHECK(Counted::live == 1);
+    }
+    CHECK(Counted::live == 0);
+}
+
+static std::string read_file(const char * path) {
+    std::string contents;
+    FILE * file = fopen(path, "r");
+    if (file == nullptr) {
+        return contents;
+    }
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+        contents.append(buffer, read);
+    }
+    fclose(file);
+    return contents;
+}
+
+static std::string owner_entry(const void * allocator, size_t objects, size_t bytes, bool global = false) {
+    char entry[128];
+    snprintf(entry, sizeof(entry), "{\"allocator\": \"%p\", \"global\": %s, \"objects\": %zu, \"bytes\": %zu,", allocator, global ? "true" : "false", objects, bytes);
+    return entry;
+}
+
+// what the operator new override hands out, sa_check_override links it
+struct Leaky {
+    char payload[80];
+};
+
+static void check_report() {
+    const char * path = "sa_check_report.json";
+    // an allocator nobody destroys shows up with what it allocated, not only with what it adopted
+    SA::Allocator * leaked = new SA::Allocator();
+    for (int i = 0; i < 1000; i++) {
+        (void) leaked->alloc<Counted>(i);
+    }
+    SA::Allocator adopting;
+    for (int i = 0; i < 10; i++) {
+        adopting.adopt(new Counted(i));
+    }
+    CHECK(SA::GET_SINGLETONS().write_report(path));
+    std::string report = read_file(path);
+    CHECK(report.find("\"owners\": [") != std::string::npos);
+    CHECK(report.find(owner_entry(leaked, 1000, 1000 * sizeof(Counted))) != std::string::npos);
+    CHECK(report.find(owner_entry(&adopting, 10, 10 * sizeof(Counted))) != std::string::npos);
+    delete leaked;
+    adopting.dealloc_all();
+    CHECK(SA::GET_SINGLETONS().write_report(path));
+    report = read_file(path);
+    CHECK(report.find(owner_entry(leaked, 1000, 1000 * sizeof(Counted))) == std::string::npos);
+    remove(path);
+    CHECK(Counted::live == 0);
+}
+
+// plain new is owned by the global allocator without being listed anywhere, the report still lists it under it
+static void check_override() {
+    const char * path = "sa_check_report.json";
+    auto & singleton = SA::GET_SINGLETONS();
+    std::string report;
+    report.reserve(1 << 20);
+    // the counters are applied in batches, flush_unlisted makes this thread's part exact
+    singleton.flush_unlisted();
+    size_t objects = singleton.unlisted_objects.load();
+    size_t bytes = singleton.unlisted_bytes.load();
+    Leaky * leaks[100];
+    for (auto & leak : leaks) {
+        leak = new Leaky();
+    }
+    singleton.flush_unlisted();
+    CHECK(singleton.unlisted_objects.load() == objects + 100);
+    CHECK(singleton.unlisted_bytes.load() == bytes + 100 * sizeof(Leaky));
+    CHECK(singleton.write_report(path));
+    report = read_file(path);
+    CHECK(report.find(owner_entry(SA::GET_GLOBAL(), objects + 100, bytes + 100 * sizeof(Leaky), true)) != std::string::npos);
+    singleton.flush_unlisted();
+    objects = singleton.unlisted_objects.load();
+    bytes = singleton.unlisted_bytes.load();
+    for (auto & leak : leaks) {
+        delete leak;
+    }
+    singleton.flush_unlisted();
+    CHECK(singleton.unlisted_objects.load() == objects - 100);
+    CHECK(singleton.unlisted_bytes.load() == bytes - 100 * sizeof(Leaky));
+    // a thread applies what it has not yet applied when it exits, the std::thread state it frees was allocated here
+    objects = singleton.unlisted_objects.load();
+    std::thread worker([&leaks] {
+        for (int i = 0; i < 10; i++) {
+            leaks[i] = new Leaky();
+        }
+    });
+    worker.join();
+    singleton.flush_unlisted();
+    CHECK(singleton.unlisted_objects.load() == objects + 10);
+    for (int i = 0; i < 10; i++) {
+        delete leaks[i];
+    }
+    singleton.flush_unlisted();
+    CHECK(singleton.unlisted_objects.load() == objects);
+    remove(path);
+}
+
+int main() {
+    if (SA::GET_GLOBAL() != nullptr) {
+        // sa_check_override, every other check adopts plain new pointers, which the global allocator keeps owning there
+        check_override();
+    } else {
+        check_pointer_map();
+        check_registry();
+        check_region();
+        check_deleters();
+        check_owners();
+        check_wipe();
+        check_batches();
+        check_moves();
+        check_usage();
+        check_splice();
+        check_teardown();
+        check_magazines();
+        check_std_adapters();
+        check_report();
+    }
+    if (failures != 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <SA.h>
+#include <string>
+#include <vector>
+
+// renders an event log written by a logging build (StackAllocatorL), one line per event in the order they were drained
+//
+// events of one thread are in order, events of different threads are grouped per drain, sort by time when interleaving
+// matters
+//
+// usage: sa_events [event log, defaults to sa_events.bin]
+
+int main(int argc, char ** argv) {
+    const char * path = argc > 1 ? argv[1] : "sa_events.bin";
+    FILE * file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    SA::EVENT_FILE_HEADER header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SA::EVENT_FILE_HEADER::expected_magic, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s is not an event log\n", path);
+        fclose(file);
+        return 1;
+    }
+    if (header.version != 1 || header.record_size != sizeof(SA::EVENT)) {
+        fprintf(stderr, "%s has version %u with %u byte records, expected version 1 with %zu byte records\n", path, header.version, header.record_size, sizeof(SA::EVENT));
+        fclose(file);
+        return 1;
+    }
+
+    std::vector<SA::EVENT> events;
+    std::vector<std::string> names;
+    SA::EVENT e;
+    while (fread(&e, sizeof(e), 1, file) == 1) {
+        if (e.op != SA::EVENT::TYPE_NAME) {
+            events.push_back(e);
+            continue;
+        }
+        std::string name(e.size, '\0');
+        size_t padded = (e.size + sizeof(SA::EVENT) - 1) / sizeof(SA::EVENT) * sizeof(SA::EVENT);
+        if (fread(&name[0], 1, e.size, file) != e.size || fseek(file, static_cast<long>(padded - e.size), SEEK_CUR) != 0) {
+            fprintf(stderr, "%s is truncated\n", path);
+            break;
+        }
+        if (names.size() <= e.type) {
+            names.resize(e.type + 1);
+        }
+        names[e.type] = name;
+    }
+    fclose(file);
+
+    uint64_t start = events.empty() ? 0 : events[0].timestamp;
+    for (auto & event : events) {
+        start = std::min(start, event.timestamp);
+    }
+    for (auto & event : events) {
+        printf("%14.3f us  thread %-4u %-18s", static_cast<double>(event.timestamp - start) / 1000.0, event.thread, SA::EVENT::op_name(event.op));
+        if (event.op == SA::EVENT::DROPPED) {
+            printf(" %llu events\n", static_cast<unsigned long long>(event.size));
+            continue;
+        }
+        if (event.pointer != 0) {
+            printf(" %p", reinterpret_cast<void*>(static_cast<uintptr_t>(event.pointer)));
+        }
+        if (event.size != 0) {
+            printf(" %llu bytes", static_cast<unsigned long long>(event.size));
+        }
+        bool aligned = event.op >= SA::EVENT::ALIGNED_NEW && event.op <= SA::EVENT::ALIGNED_DELETE_ARRAY;
+        if (aligned) {
+            printf(" align %llu", static_cast<unsigned long long>(event.type));
+        } else if (event.type != SA::EVENT::no_type) {
+            printf(" '%s'", event.type < names.size() && !names[event.type].empty() ? names[event.type].c_str() : "unnamed type");
+        }
+        if (event.owner != 0) {
+            printf(" owner %p", reinterpret_cast<void*>(static_cast<uintptr_t>(event.owner)));
+        }
+        printf("\n");
+    }
+    return 0;
+}